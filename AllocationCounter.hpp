@@ -0,0 +1,13 @@
+#ifndef AllocationCounter_hpp
+#define AllocationCounter_hpp
+
+#include <cstddef>
+
+namespace gps {
+
+    // Number of calls to the global operator new (scalar and array) made by any thread since
+    // start-up. Memory the drivers or C libraries get through malloc is not counted
+    size_t getAllocationCount();
+}
+
+#endif /* AllocationCounter_hpp */
@@ -0,0 +1,325 @@
+#include "Bvh.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace gps {
+
+	// Candidate split planes tested per axis
+	const int SAH_BINS = 12;
+	// Relative cost of visiting an inner node against testing one item
+	const float SAH_TRAVERSAL_COST = 1.0f;
+	// Depth-first queries keep at most one entry per level plus one on their fixed stacks, so
+	// the build stops splitting at BVH_MAX_DEPTH
+	const int BVH_STACK_SIZE = 64;
+	const int BVH_MAX_DEPTH = BVH_STACK_SIZE - 2;
+	// Set on a stack entry of queryFrustum() whose node is known to be inside the frustum
+	const uint32_t NODE_INSIDE = 0x80000000u;
+
+	static float surfaceArea(const gps::BoundingBox& box) {
+		glm::vec3 size = box.max - box.min;
+		return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+	}
+
+	static gps::BoundingBox emptyBox() {
+		gps::BoundingBox box;
+		box.min = glm::vec3(std::numeric_limits<float>::max());
+		box.max = glm::vec3(-std::numeric_limits<float>::max());
+		return box;
+	}
+
+	static void growBox(gps::BoundingBox& box, const gps::BoundingBox& other) {
+		box.min = glm::min(box.min, other.min);
+		box.max = glm::max(box.max, other.max);
+	}
+
+	static bool overlaps(const gps::BoundingBox& a, const gps::BoundingBox& b) {
+		return a.min.x <= b.max.x && a.max.x >= b.min.x
+			&& a.min.y <= b.max.y && a.max.y >= b.min.y
+			&& a.min.z <= b.max.z && a.max.z >= b.min.z;
+	}
+
+	// Slab test; returns the entry distance, or infinity if the ray misses within maxDistance
+	static float rayEntry(const gps::BoundingBox& box, const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance) {
+		glm::vec3 t0 = (box.min - origin) * inverseDirection;
+		glm::vec3 t1 = (box.max - origin) * inverseDirection;
+		glm::vec3 entries = glm::min(t0, t1);
+		glm::vec3 exits = glm::max(t0, t1);
+		float entry = std::max(std::max(entries.x, entries.y), std::max(entries.z, 0.0f));
+		float exit = std::min(std::min(exits.x, exits.y), std::min(exits.z, maxDistance));
+		return entry <= exit ? entry : std::numeric_limits<float>::infinity();
+	}
+
+	void Bvh::build(const std::vector<gps::BoundingBox>& boxes) {
+		nodes.clear();
+		itemBounds = boxes;
+		itemList.resize(boxes.size());
+		centroids.resize(boxes.size());
+		for (size_t i = 0; i < boxes.size(); i++) {
+			itemList[i] = (uint32_t)i;
+			centroids[i] = (boxes[i].min + boxes[i].max) * 0.5f;
+		}
+		if (boxes.empty()) {
+			return;
+		}
+
+		// A binary tree over n items has at most 2n - 1 nodes
+		nodes.reserve(boxes.size() * 2);
+		gps::BvhNode root;
+		root.first = 0;
+		root.count = (uint32_t)boxes.size();
+		nodes.push_back(root);
+		updateBounds(nodes[0]);
+		subdivide(0, 0);
+
+		std::vector<glm::vec3>().swap(centroids);
+	}
+
+	void Bvh::updateBounds(gps::BvhNode& node) const {
+		node.bounds = emptyBox();
+		for (uint32_t i = 0; i < node.count; i++) {
+			growBox(node.bounds, itemBounds[itemList[node.first + i]]);
+		}
+	}
+
+	void Bvh::subdivide(uint32_t nodeIndex, int depth) {
+		uint32_t first = nodes[nodeIndex].first;
+		uint32_t count = nodes[nodeIndex].count;
+		if (count <= 1 || depth >= BVH_MAX_DEPTH) {
+			return;
+		}
+
+		gps::BoundingBox centroidBounds = emptyBox();
+		for (uint32_t i = 0; i < count; i++) {
+			const glm::vec3& centroid = centroids[itemList[first + i]];
+			centroidBounds.min = glm::min(centroidBounds.min, centroid);
+			centroidBounds.max = glm::max(centroidBounds.max, centroid);
+		}
+
+		// Cheapest split over the bins of every axis; costs are in units of one item test
+		// weighted by surface area, relative to this node's
+		int bestAxis = -1;
+		int bestSplit = 0;
+		float bestCost = std::numeric_limits<float>::max();
+		for (int axis = 0; axis < 3; axis++) {
+			float axisMin = centroidBounds.min[axis];
+			float axisExtent = centroidBounds.max[axis] - axisMin;
+			if (axisExtent <= 0.0f) {
+				continue;
+			}
+
+			gps::BoundingBox binBounds[SAH_BINS];
+			uint32_t binCounts[SAH_BINS] = {};
+			for (int b = 0; b < SAH_BINS; b++) {
+				binBounds[b] = emptyBox();
+			}
+			float binScale = SAH_BINS / axisExtent;
+			for (uint32_t i = 0; i < count; i++) {
+				uint32_t item = itemList[first + i];
+				int b = std::min(SAH_BINS - 1, (int)((centroids[item][axis] - axisMin) * binScale));
+				binCounts[b]++;
+				growBox(binBounds[b], itemBounds[item]);
+			}
+
+			// Sweep from both ends to get the cost of every plane between bins
+			float leftArea[SAH_BINS - 1];
+			uint32_t leftCount[SAH_BINS - 1];
+			gps::BoundingBox sweep = emptyBox();
+			uint32_t sweepCount = 0;
+			for (int b = 0; b < SAH_BINS - 1; b++) {
+				growBox(sweep, binBounds[b]);
+				sweepCount += binCounts[b];
+				leftArea[b] = sweepCount > 0 ? surfaceArea(sweep) : 0.0f;
+				leftCount[b] = sweepCount;
+			}
+			sweep = emptyBox();
+			sweepCount = 0;
+			for (int b = SAH_BINS - 1; b > 0; b--) {
+				growBox(sweep, binBounds[b]);
+				sweepCount += binCounts[b];
+				float rightArea = sweepCount > 0 ? surfaceArea(sweep) : 0.0f;
+				float cost = leftCount[b - 1] * leftArea[b - 1] + sweepCount * rightArea;
+				if (leftCount[b - 1] > 0 && sweepCount > 0 && cost < bestCost) {
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = b;
+				}
+			}
+		}
+
+		float nodeArea = surfaceArea(nodes[nodeIndex].bounds);
+		float leafCost = (float)count;
+		if (bestAxis < 0 || (nodeArea > 0.0f && SAH_TRAVERSAL_COST + bestCost / nodeArea >= leafCost)) {
+			return;
+		}
+
+		// Partition the item list around the chosen plane
+		float axisMin = centroidBounds.min[bestAxis];
+		float binScale = SAH_BINS / (centroidBounds.max[bestAxis] - axisMin);
+		uint32_t* begin = &itemList[first];
+		uint32_t* middle = std::partition(begin, begin + count, [&](uint32_t item) {
+			return std::min(SAH_BINS - 1, (int)((centroids[item][bestAxis] - axisMin) * binScale)) < bestSplit;
+		});
+		uint32_t leftItems = (uint32_t)(middle - begin);
+
+		uint32_t leftIndex = (uint32_t)nodes.size();
+		gps::BvhNode left;
+		left.first = first;
+		left.count = leftItems;
+		gps::BvhNode right;
+		right.first = first + leftItems;
+		right.count = count - leftItems;
+		nodes.push_back(left);
+		nodes.push_back(right);
+		updateBounds(nodes[leftIndex]);
+		updateBounds(nodes[leftIndex + 1]);
+
+		nodes[nodeIndex].first = leftIndex;
+		nodes[nodeIndex].count = 0;
+		subdivide(leftIndex, depth + 1);
+		subdivide(leftIndex + 1, depth + 1);
+	}
+
+	void Bvh::refit(const std::vector<gps::BoundingBox>& boxes) {
+		itemBounds = boxes;
+
+		// Children come after their parents, so a backwards walk visits them first
+		for (size_t n = nodes.size(); n-- > 0;) {
+			gps::BvhNode& node = nodes[n];
+			if (node.count > 0) {
+				updateBounds(node);
+			}
+			else {
+				node.bounds = nodes[node.first].bounds;
+				growBox(node.bounds, nodes[node.first + 1].bounds);
+			}
+		}
+	}
+
+	void Bvh::queryFrustum(const gps::Frustum& frustum, std::vector<uint32_t>& items) const {
+		if (nodes.empty()) {
+			return;
+		}
+
+		uint32_t stack[BVH_STACK_SIZE];
+		int stackSize = 0;
+		stack[stackSize++] = 0;
+		while (stackSize > 0) {
+			uint32_t entry = stack[--stackSize];
+			const gps::BvhNode& node = nodes[entry & ~NODE_INSIDE];
+
+			// Everything below a node inside the frustum is visible without further tests
+			uint32_t inside = entry & NODE_INSIDE;
+			if (!inside) {
+				if (!frustum.intersects(node.bounds)) {
+					continue;
+				}
+				if (frustum.contains(node.bounds)) {
+					inside = NODE_INSIDE;
+				}
+			}
+
+			if (node.count > 0) {
+				for (uint32_t i = 0; i < node.count; i++) {
+					uint32_t item = itemList[node.first + i];
+					if (inside || node.count == 1 || frustum.intersects(itemBounds[item])) {
+						items.push_back(item);
+					}
+				}
+			}
+			else {
+				stack[stackSize++] = node.first | inside;
+				stack[stackSize++] = (node.first + 1) | inside;
+			}
+		}
+	}
+
+	void Bvh::queryOverlap(const gps::BoundingBox& box, std::vector<uint32_t>& items) const {
+		if (nodes.empty()) {
+			return;
+		}
+
+		uint32_t stack[BVH_STACK_SIZE];
+		int stackSize = 0;
+		stack[stackSize++] = 0;
+		while (stackSize > 0) {
+			const gps::BvhNode& node = nodes[stack[--stackSize]];
+			if (!overlaps(node.bounds, box)) {
+				continue;
+			}
+
+			if (node.count > 0) {
+				for (uint32_t i = 0; i < node.count; i++) {
+					uint32_t item = itemList[node.first + i];
+					if (node.count == 1 || overlaps(itemBounds[item], box)) {
+						items.push_back(item);
+					}
+				}
+			}
+			else {
+				stack[stackSize++] = node.first;
+				stack[stackSize++] = node.first + 1;
+			}
+		}
+	}
+
+	int32_t Bvh::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float* hitDistance) const {
+		int32_t hitItem = -1;
+		float nearest = maxDistance;
+		if (nodes.empty()) {
+			return hitItem;
+		}
+
+		// Division by a zero component gives an infinite slab, which IEEE arithmetic handles
+		glm::vec3 inverseDirection = 1.0f / direction;
+		uint32_t stack[BVH_STACK_SIZE];
+		int stackSize = 0;
+		if (rayEntry(nodes[0].bounds, origin, inverseDirection, nearest) <= nearest) {
+			stack[stackSize++] = 0;
+		}
+
+		while (stackSize > 0) {
+			const gps::BvhNode& node = nodes[stack[--stackSize]];
+			if (node.count > 0) {
+				for (uint32_t i = 0; i < node.count; i++) {
+					uint32_t item = itemList[node.first + i];
+					float entry = rayEntry(itemBounds[item], origin, inverseDirection, nearest);
+					if (entry <= nearest) {
+						nearest = entry;
+						hitItem = (int32_t)item;
+					}
+				}
+				continue;
+			}
+
+			// Visit the nearer child first so the further one is usually pruned
+			float leftEntry = rayEntry(nodes[node.first].bounds, origin, inverseDirection, nearest);
+			float rightEntry = rayEntry(nodes[node.first + 1].bounds, origin, inverseDirection, nearest);
+			uint32_t nearChild = node.first;
+			uint32_t farChild = node.first + 1;
+			if (rightEntry < leftEntry) {
+				std::swap(leftEntry, rightEntry);
+				std::swap(nearChild, farChild);
+			}
+			if (rightEntry <= nearest) {
+				stack[stackSize++] = farChild;
+			}
+			if (leftEntry <= nearest) {
+				stack[stackSize++] = nearChild;
+			}
+		}
+
+		if (hitItem >= 0 && hitDistance != NULL) {
+			*hitDistance = nearest;
+		}
+		return hitItem;
+	}
+
+	size_t Bvh::getNodeCount() const {
+		return nodes.size();
+	}
+
+	size_t Bvh::getItemCount() const {
+		return itemBounds.size();
+	}
+}
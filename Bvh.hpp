@@ -0,0 +1,64 @@
+#ifndef Bvh_hpp
+#define Bvh_hpp
+
+#include "Frustum.hpp"
+#include "Mesh.hpp"
+
+#include "glm/glm.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace gps {
+
+    // Node of the flattened tree. An inner node's children are stored next to each other at
+    // nodes[first] and nodes[first + 1], always after their parent
+    struct BvhNode {
+        gps::BoundingBox bounds;
+        // First child for inner nodes, first entry of the item list for leaves
+        uint32_t first;
+        // Items in a leaf, 0 for inner nodes
+        uint32_t count;
+    };
+
+    // Bounding volume hierarchy over a set of boxes (item i is boxes[i]), built with the
+    // surface area heuristic. Moving items are handled by refit(), which keeps the tree shape;
+    // rebuild once the items have moved far from where the tree was built
+    class Bvh
+    {
+    public:
+        void build(const std::vector<gps::BoundingBox>& boxes);
+
+        // Updates the item boxes (same items, same order as in build) and every node's bounds
+        void refit(const std::vector<gps::BoundingBox>& boxes);
+
+        // Appends to items every item whose box intersects the frustum (see Frustum::intersects)
+        void queryFrustum(const gps::Frustum& frustum, std::vector<uint32_t>& items) const;
+
+        // Appends to items every item whose box overlaps the box
+        void queryOverlap(const gps::BoundingBox& box, std::vector<uint32_t>& items) const;
+
+        // The item whose box the ray enters first within maxDistance, or -1; the distance along
+        // direction (which need not be normalized) is stored in hitDistance. Rays starting
+        // inside a box hit it at distance 0
+        int32_t raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float* hitDistance) const;
+
+        size_t getNodeCount() const;
+        size_t getItemCount() const;
+
+    private:
+        std::vector<gps::BvhNode> nodes;
+        // Leaves index into this list, which holds item numbers grouped by leaf
+        std::vector<uint32_t> itemList;
+        std::vector<gps::BoundingBox> itemBounds;
+        // Used while building only
+        std::vector<glm::vec3> centroids;
+
+        // Splits a node along the cheapest binned SAH plane until splitting no longer pays off
+        void subdivide(uint32_t nodeIndex, int depth);
+        void updateBounds(gps::BvhNode& node) const;
+    };
+}
+
+#endif /* Bvh_hpp */
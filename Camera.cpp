@@ -5,6 +5,7 @@ namespace gps {
     //Camera constructor
     Camera::Camera(glm::vec3 cameraPosition, glm::vec3 cameraTarget, glm::vec3 cameraUp) {
         this->cameraPosition = cameraPosition;
+        this->previousPosition = cameraPosition;
         this->cameraTarget = cameraTarget;
 
         this->cameraFrontDirection = glm::normalize(cameraTarget - cameraPosition);
@@ -18,6 +19,15 @@ namespace gps {
         return glm::lookAt(cameraPosition, cameraPosition + this->cameraFrontDirection, glm::vec3(0.0, 1.0, 0.0));
     }
 
+    glm::mat4 Camera::getViewMatrix(float alpha) {
+        glm::vec3 position = glm::mix(previousPosition, cameraPosition, alpha);
+        return glm::lookAt(position, position + this->cameraFrontDirection, glm::vec3(0.0, 1.0, 0.0));
+    }
+
+    void Camera::savePosition() {
+        this->previousPosition = cameraPosition;
+    }
+
     //update the camera internal parameters following a camera move event
     void Camera::move(MOVE_DIRECTION direction, float speed) {
         switch (direction) {
@@ -17,6 +17,11 @@ namespace gps {
         Camera(glm::vec3 cameraPosition, glm::vec3 cameraTarget, glm::vec3 cameraUp);
         //return the view matrix, using the glm::lookAt() function
         glm::mat4 getViewMatrix();
+        //return the view matrix at a position blended between the one saved by savePosition()
+        //(alpha = 0) and the current one (alpha = 1)
+        glm::mat4 getViewMatrix(float alpha);
+        //remember the current position as the start of the next simulation tick
+        void savePosition();
         //update the camera internal parameters following a camera move event
         void move(MOVE_DIRECTION direction, float speed);
         //update the camera internal parameters following a camera rotate event
@@ -31,6 +36,7 @@ namespace gps {
         
     private:
         glm::vec3 cameraPosition;
+        glm::vec3 previousPosition;
         glm::vec3 cameraTarget;
         glm::vec3 cameraFrontDirection;
         glm::vec3 cameraRightDirection;
@@ -0,0 +1,234 @@
+#include "CascadedShadowMap.hpp"
+#include "GLState.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace gps {
+
+	const UniformName CASCADE_SPLIT_NAMES[MAX_SHADOW_CASCADES] = {
+		"cascadeSplits[0]", "cascadeSplits[1]", "cascadeSplits[2]", "cascadeSplits[3]"
+	};
+	const UniformName CASCADE_MATRIX_NAMES[MAX_SHADOW_CASCADES] = {
+		"lightSpaceTrMatrices[0]", "lightSpaceTrMatrices[1]", "lightSpaceTrMatrices[2]", "lightSpaceTrMatrices[3]"
+	};
+
+	const char* getShadowFilterName(SHADOW_FILTER filter) {
+		static const char* names[FILTER_COUNT] = {"nearest", "pcf", "pcf-grid", "poisson", "manual-5x5"};
+		return filter >= 0 && filter < FILTER_COUNT ? names[filter] : "unknown";
+	}
+
+	void CascadedShadowMap::init(const ShadowSettings& shadowSettings) {
+		GLint maxSize = 0;
+		glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+		settings = shadowSettings;
+		settings.cascadeCount = std::min(std::max(settings.cascadeCount, MIN_SHADOW_CASCADES), MAX_SHADOW_CASCADES);
+		settings.resolution = std::min(std::max(settings.resolution, (GLsizei)128), (GLsizei)maxSize);
+
+		if (settings.filter < 0 || settings.filter >= FILTER_COUNT) {
+			settings.filter = FILTER_PCF;
+		}
+
+		createLayers(depthTexture, framebuffer);
+		if (settings.cacheStatic) {
+			createLayers(staticTexture, staticFramebuffer);
+		}
+
+		// The same texture is read with bilinear depth comparisons and as plain depth values
+		GLuint samplerIds[2];
+		glGenSamplers(2, samplerIds);
+		compareSampler.reset(samplerIds[0]);
+		depthSampler.reset(samplerIds[1]);
+		glSamplerParameteri(compareSampler.get(), GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glSamplerParameteri(compareSampler.get(), GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glSamplerParameteri(compareSampler.get(), GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+		glSamplerParameteri(compareSampler.get(), GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+		glSamplerParameteri(depthSampler.get(), GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glSamplerParameteri(depthSampler.get(), GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glSamplerParameteri(depthSampler.get(), GL_TEXTURE_COMPARE_MODE, GL_NONE);
+		for (int i = 0; i < 2; i++) {
+			glSamplerParameteri(samplerIds[i], GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glSamplerParameteri(samplerIds[i], GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		}
+
+		for (int c = 0; c < MAX_SHADOW_CASCADES; c++) {
+			cascadeViews[c] = glm::mat4(1.0f);
+			cascadeDepths[c] = 1.0f;
+			lightSpaceMatrices[c] = glm::mat4(1.0f);
+			splitDistances[c] = 0.0f;
+			staticValid[c] = false;
+			staticMatrices[c] = glm::mat4(1.0f);
+			staticRevisions[c] = 0;
+		}
+
+		printf("Shadows        : %d cascades of %dx%d up to %.0f, static casters %s, %s filter\n", settings.cascadeCount, settings.resolution,
+			settings.resolution, settings.distance, settings.cacheStatic ? "cached" : "redrawn every frame", getShadowFilterName(settings.filter));
+	}
+
+	void CascadedShadowMap::reset() {
+		framebuffer.reset();
+		depthTexture.reset();
+		staticFramebuffer.reset();
+		staticTexture.reset();
+		compareSampler.reset();
+		depthSampler.reset();
+	}
+
+	void CascadedShadowMap::createLayers(gps::TextureHandle& texture, gps::FramebufferHandle& layerFramebuffer) {
+		GLuint framebufferId;
+		GLuint textureId;
+		glGenFramebuffers(1, &framebufferId);
+		glGenTextures(1, &textureId);
+		layerFramebuffer.reset(framebufferId);
+		texture.reset(textureId);
+
+		GLState& state = GLState::getInstance();
+		state.bindTexture(0, GL_TEXTURE_2D_ARRAY, texture.get());
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, settings.resolution, settings.resolution, settings.cascadeCount,
+			0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		state.bindFramebuffer(layerFramebuffer.get());
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture.get(), 0, 0);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+		state.bindFramebuffer(0);
+	}
+
+	void CascadedShadowMap::update(const glm::mat4& cameraView, float fovy, float aspect, float cameraNear, const glm::vec3& lightDirection) {
+		glm::mat4 inverseCameraView = glm::inverse(cameraView);
+		glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), -glm::normalize(lightDirection), glm::vec3(0.0f, 1.0f, 0.0f));
+		float tanHalfHeight = std::tan(fovy * 0.5f);
+		float tanHalfWidth = tanHalfHeight * aspect;
+
+		float sliceNear = cameraNear;
+		for (int c = 0; c < settings.cascadeCount; c++) {
+			// Blend of the geometric and the even split (the "practical" split scheme)
+			float fraction = (float)(c + 1) / settings.cascadeCount;
+			float geometric = cameraNear * std::pow(settings.distance / cameraNear, fraction);
+			float even = cameraNear + (settings.distance - cameraNear) * fraction;
+			float sliceFar = settings.splitLambda * geometric + (1.0f - settings.splitLambda) * even;
+			splitDistances[c] = sliceFar;
+
+			// Bounding sphere of the slice, centered on its axis. The center is where it is
+			// equally far from the near and the far corners (or at the far plane for wide slices)
+			float nearDiagonal = sliceNear * sliceNear * (tanHalfWidth * tanHalfWidth + tanHalfHeight * tanHalfHeight);
+			float farDiagonal = sliceFar * sliceFar * (tanHalfWidth * tanHalfWidth + tanHalfHeight * tanHalfHeight);
+			float centerDistance = std::min(sliceFar, 0.5f * (sliceNear + sliceFar) + 0.5f * (farDiagonal - nearDiagonal) / (sliceFar - sliceNear));
+			float radius = std::sqrt((sliceFar - centerDistance) * (sliceFar - centerDistance) + farDiagonal);
+			// Rounded up so float noise in the fit cannot change the texel size from frame to frame
+			radius = std::ceil(radius * 16.0f) / 16.0f;
+
+			glm::vec3 center = glm::vec3(inverseCameraView * glm::vec4(0.0f, 0.0f, -centerDistance, 1.0f));
+			glm::vec3 lightCenter = glm::vec3(lightView * glm::vec4(center, 1.0f));
+
+			// Move the projection in whole texels only
+			float texelSize = 2.0f * radius / settings.resolution;
+			lightCenter.x = std::floor(lightCenter.x / texelSize) * texelSize;
+			lightCenter.y = std::floor(lightCenter.y / texelSize) * texelSize;
+
+			// Depth is measured from the side of the sphere facing the light
+			cascadeViews[c] = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -(lightCenter.z + radius))) * lightView;
+			cascadeDepths[c] = 2.0f * radius;
+			glm::mat4 projection = glm::ortho(lightCenter.x - radius, lightCenter.x + radius,
+				lightCenter.y - radius, lightCenter.y + radius, 0.0f, cascadeDepths[c]);
+			lightSpaceMatrices[c] = projection * cascadeViews[c];
+
+			sliceNear = sliceFar;
+		}
+	}
+
+	bool CascadedShadowMap::beginStaticCascade(int cascade, uint32_t staticRevision) {
+		if (!settings.cacheStatic) {
+			return false;
+		}
+		if (staticValid[cascade] && staticRevisions[cascade] == staticRevision && staticMatrices[cascade] == lightSpaceMatrices[cascade]) {
+			return false;
+		}
+		staticValid[cascade] = true;
+		staticRevisions[cascade] = staticRevision;
+		staticMatrices[cascade] = lightSpaceMatrices[cascade];
+
+		GLState& state = GLState::getInstance();
+		state.bindFramebuffer(staticFramebuffer.get());
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, staticTexture.get(), 0, cascade);
+		state.viewport(0, 0, settings.resolution, settings.resolution);
+		glClear(GL_DEPTH_BUFFER_BIT);
+		return true;
+	}
+
+	void CascadedShadowMap::beginCascade(int cascade) {
+		GLState& state = GLState::getInstance();
+		state.bindFramebuffer(framebuffer.get());
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture.get(), 0, cascade);
+		state.viewport(0, 0, settings.resolution, settings.resolution);
+		if (!settings.cacheStatic) {
+			glClear(GL_DEPTH_BUFFER_BIT);
+			return;
+		}
+
+		// Only the read binding changes; GLState keeps tracking the framebuffer drawn into
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, staticFramebuffer.get());
+		glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, staticTexture.get(), 0, cascade);
+		glBlitFramebuffer(0, 0, settings.resolution, settings.resolution, 0, 0, settings.resolution, settings.resolution,
+			GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer.get());
+	}
+
+	const gps::ShadowSettings& CascadedShadowMap::getSettings() const {
+		return settings;
+	}
+
+	void CascadedShadowMap::setFilter(SHADOW_FILTER filter) {
+		if (filter >= 0 && filter < FILTER_COUNT) {
+			settings.filter = filter;
+		}
+	}
+
+	const glm::mat4& CascadedShadowMap::getCascadeView(int cascade) const {
+		return cascadeViews[cascade];
+	}
+
+	float CascadedShadowMap::getCascadeDepth(int cascade) const {
+		return cascadeDepths[cascade];
+	}
+
+	const glm::mat4& CascadedShadowMap::getLightSpaceMatrix(int cascade) const {
+		return lightSpaceMatrices[cascade];
+	}
+
+	GLuint CascadedShadowMap::getTexture() const {
+		return depthTexture.get();
+	}
+
+	void CascadedShadowMap::bindTextures(GLuint textureUnit) const {
+		GLState& state = GLState::getInstance();
+		state.bindTexture(textureUnit, GL_TEXTURE_2D_ARRAY, depthTexture.get());
+		state.bindTexture(textureUnit + 1, GL_TEXTURE_2D_ARRAY, depthTexture.get());
+		// Only these two units ever use samplers, so they are bound without tracking
+		glBindSampler(textureUnit, compareSampler.get());
+		glBindSampler(textureUnit + 1, depthSampler.get());
+	}
+
+	void CascadedShadowMap::setUniforms(gps::Shader& shader, GLuint textureUnit) const {
+		bindTextures(textureUnit);
+		shader.setInt("shadowMap", (GLint)textureUnit);
+		shader.setInt("shadowDepth", (GLint)textureUnit + 1);
+		shader.setInt("shadowFilter", (GLint)settings.filter);
+		shader.setFloat("shadowTexelSize", 1.0f / settings.resolution);
+		shader.setFloat("shadowFilterRadius", settings.filterRadius);
+		shader.setFloat("shadowConstantBias", settings.constantBias);
+		shader.setFloat("shadowSlopeBias", settings.slopeBias);
+		shader.setInt("cascadeCount", settings.cascadeCount);
+		for (int c = 0; c < settings.cascadeCount; c++) {
+			shader.setFloat(CASCADE_SPLIT_NAMES[c], splitDistances[c]);
+			shader.setMat4(CASCADE_MATRIX_NAMES[c], lightSpaceMatrices[c]);
+		}
+	}
+}
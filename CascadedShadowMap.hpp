@@ -0,0 +1,120 @@
+#ifndef CascadedShadowMap_hpp
+#define CascadedShadowMap_hpp
+
+#include <GL/glew.h>
+#include "glm/glm.hpp"
+
+#include <cstdint>
+
+#include "GLHandle.hpp"
+#include "Shader.hpp"
+
+namespace gps {
+
+    // Size of the cascade arrays in the shaders
+    const int MAX_SHADOW_CASCADES = 4;
+    // A single cascade would stretch one map over the whole shadow distance
+    const int MIN_SHADOW_CASCADES = 2;
+
+    // How shadowed a fragment is, from one point-sampled comparison (hard, aliased edges) to
+    // hardware comparisons, which filter 2x2 texels per tap: one tap, a 3x3 grid of taps, or 16
+    // taps on a Poisson disk rotated per pixel. FILTER_MANUAL_5X5 compares 25 point samples in
+    // the shader, for comparing the cost of a large manual kernel against the hardware ones
+    enum SHADOW_FILTER {FILTER_NEAREST, FILTER_PCF, FILTER_PCF_GRID, FILTER_POISSON, FILTER_MANUAL_5X5, FILTER_COUNT};
+
+    // Short name of the filter, for reports and the command line
+    const char* getShadowFilterName(SHADOW_FILTER filter);
+
+    // Quality against cost: each cascade is one resolution x resolution layer of the depth
+    // texture, drawn with the casters inside its part of the view
+    struct ShadowSettings {
+        int cascadeCount;
+        GLsizei resolution;
+        // Shadows end this far from the camera
+        float distance;
+        // How the view is split: 0 for equal lengths, 1 for a geometric series
+        float splitLambda;
+        // Keep the depth of the static casters in a second texture array and only draw the
+        // dynamic ones every frame
+        bool cacheStatic;
+        SHADOW_FILTER filter;
+        // Poisson disk radius, in texels
+        float filterRadius;
+        // Depth bias in texels of depth, plus slopeBias times the tangent of the angle between
+        // the light and the surface for each texel the filter reaches
+        float constantBias;
+        float slopeBias;
+    };
+
+    // Directional light shadows split into cascades along the camera view, stored in the
+    // layers of one depth texture array. Each cascade covers the bounding sphere of a slice of
+    // the camera frustum with a square orthographic projection. Its size only changes with the
+    // camera projection, and its origin is snapped to whole texels, so the shadow edges don't
+    // shimmer as the camera moves and turns.
+    // With cacheStatic, the static casters of each cascade are drawn into their own layer only
+    // when the cascade moves or the scene revision changes; every frame that layer is copied into
+    // the shadow map and the dynamic casters are drawn on top
+    class CascadedShadowMap
+    {
+    public:
+        // Creates the depth texture array, its samplers and the framebuffer; the count and
+        // resolution are clamped
+        void init(const ShadowSettings& settings);
+        // Deletes the texture and framebuffer; call while the context still exists
+        void reset();
+
+        // Fits the cascades to the camera, whose projection is a perspective with the given
+        // vertical field of view (radians), aspect and near plane. lightDirection points towards the light
+        void update(const glm::mat4& cameraView, float fovy, float aspect, float cameraNear, const glm::vec3& lightDirection);
+
+        // With cacheStatic, returns whether the cascade's static layer must be redrawn for this
+        // revision of the static casters; if so, binds it, sets the viewport and clears it, and
+        // the static casters are to be drawn next. Returns false without cacheStatic
+        bool beginStaticCascade(int cascade, uint32_t staticRevision);
+
+        // Attaches the cascade's layer to the framebuffer, binds it, sets the viewport and starts
+        // it from the static layer (with cacheStatic) or clears it; the casters left are drawn next
+        void beginCascade(int cascade);
+
+        const gps::ShadowSettings& getSettings() const;
+        // Takes effect at the next setUniforms
+        void setFilter(SHADOW_FILTER filter);
+        // Light view whose depth starts at the cascade's near plane, and the depth of its far plane
+        const glm::mat4& getCascadeView(int cascade) const;
+        float getCascadeDepth(int cascade) const;
+        const glm::mat4& getLightSpaceMatrix(int cascade) const;
+        GLuint getTexture() const;
+
+        // Binds the texture array to the unit with depth comparison (for a sampler2DArrayShadow)
+        // and to the next unit without (for a sampler2DArray)
+        void bindTextures(GLuint textureUnit) const;
+
+        // Binds the textures as above and sets shadowMap, shadowDepth, the cascade uniforms and
+        // the filter uniforms
+        void setUniforms(gps::Shader& shader, GLuint textureUnit) const;
+
+    private:
+        gps::ShadowSettings settings;
+        gps::TextureHandle depthTexture;
+        gps::FramebufferHandle framebuffer;
+        gps::SamplerHandle compareSampler;
+        gps::SamplerHandle depthSampler;
+        gps::TextureHandle staticTexture;
+        gps::FramebufferHandle staticFramebuffer;
+
+        glm::mat4 cascadeViews[MAX_SHADOW_CASCADES];
+        float cascadeDepths[MAX_SHADOW_CASCADES];
+        glm::mat4 lightSpaceMatrices[MAX_SHADOW_CASCADES];
+        // View distance where each cascade ends
+        float splitDistances[MAX_SHADOW_CASCADES];
+        // What each static layer was drawn with
+        bool staticValid[MAX_SHADOW_CASCADES];
+        glm::mat4 staticMatrices[MAX_SHADOW_CASCADES];
+        uint32_t staticRevisions[MAX_SHADOW_CASCADES];
+
+        // Creates a depth texture array with a layer per cascade and a framebuffer drawing into it
+        void createLayers(gps::TextureHandle& texture, gps::FramebufferHandle& layerFramebuffer);
+    };
+}
+
+#endif /* CascadedShadowMap_hpp */
@@ -0,0 +1,194 @@
+#include "ClusteredLights.hpp"
+#include "Frustum.hpp"
+#include "GLState.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace gps {
+
+	// Floats per visible light in lightData
+	const size_t LIGHT_FLOATS = 8;
+
+	ClusteredLights::ClusteredLights() : lightBufferSize(0), rangeBufferSize(0), indexBufferSize(0), tileScale(0.0f),
+		sliceScale(0.0f), sliceBias(0.0f) {
+	}
+
+	void ClusteredLights::init() {
+		GLuint bufferIds[3];
+		GLuint textureIds[3];
+		glGenBuffers(3, bufferIds);
+		glGenTextures(3, textureIds);
+		lightBuffer.reset(bufferIds[0]);
+		rangeBuffer.reset(bufferIds[1]);
+		indexBuffer.reset(bufferIds[2]);
+		lightTexture.reset(textureIds[0]);
+		rangeTexture.reset(textureIds[1]);
+		indexTexture.reset(textureIds[2]);
+		lightBufferSize = 0;
+		rangeBufferSize = 0;
+		indexBufferSize = 0;
+
+		clusterRanges.assign(2 * CLUSTER_COUNT, 0);
+	}
+
+	void ClusteredLights::reset() {
+		lightTexture.reset();
+		rangeTexture.reset();
+		indexTexture.reset();
+		lightBuffer.reset();
+		rangeBuffer.reset();
+		indexBuffer.reset();
+	}
+
+	uint32_t ClusteredLights::addLight(const gps::PointLight& light) {
+		lights.push_back(light);
+		return (uint32_t)(lights.size() - 1);
+	}
+
+	void ClusteredLights::setLightPosition(uint32_t light, const glm::vec3& position) {
+		lights[light].position = position;
+	}
+
+	size_t ClusteredLights::getLightCount() const {
+		return lights.size();
+	}
+
+	void ClusteredLights::update(const glm::mat4& view, float fovy, float aspect, float nearPlane, float farPlane, int width, int height) {
+		gps::Frustum frustum(glm::perspective(fovy, aspect, nearPlane, farPlane) * view);
+		float tanY = tanf(0.5f * fovy);
+		float tanX = tanY * aspect;
+
+		// slice = log(depth) * sliceScale + sliceBias, so slice s starts at near * (far / near)^(s / SLICES)
+		float logRatio = logf(farPlane / nearPlane);
+		sliceScale = (float)CLUSTER_SLICES / logRatio;
+		sliceBias = -(float)CLUSTER_SLICES * logf(nearPlane) / logRatio;
+		tileScale = glm::vec2((float)CLUSTER_TILES_X / (float)std::max(width, 1), (float)CLUSTER_TILES_Y / (float)std::max(height, 1));
+
+		lightData.clear();
+		rects.clear();
+		for (size_t i = 0; i < lights.size(); i++) {
+			const PointLight& light = lights[i];
+			gps::BoundingSphere sphere = {light.position, light.radius};
+			if (!frustum.intersects(sphere)) {
+				continue;
+			}
+
+			uint32_t visibleLight = (uint32_t)(lightData.size() / LIGHT_FLOATS);
+			glm::vec3 center = glm::vec3(view * glm::vec4(light.position, 1.0f));
+			float radius = light.radius;
+			float data[LIGHT_FLOATS] = {center.x, center.y, center.z, radius, light.color.x, light.color.y, light.color.z, (float)light.shadow};
+			lightData.insert(lightData.end(), data, data + LIGHT_FLOATS);
+
+			float depth = -center.z;
+			float minDepth = std::max(depth - radius, nearPlane);
+			float maxDepth = std::min(depth + radius, farPlane);
+			int firstSlice = std::min(std::max((int)floorf(logf(minDepth) * sliceScale + sliceBias), 0), CLUSTER_SLICES - 1);
+			int lastSlice = std::min(std::max((int)floorf(logf(maxDepth) * sliceScale + sliceBias), 0), CLUSTER_SLICES - 1);
+			for (int slice = firstSlice; slice <= lastSlice; slice++) {
+				float sliceNear = std::max(nearPlane * expf(logRatio * (float)slice / (float)CLUSTER_SLICES), minDepth);
+				float sliceFar = std::min(nearPlane * expf(logRatio * (float)(slice + 1) / (float)CLUSTER_SLICES), maxDepth);
+
+				// The widest cross-section of the sphere within the slice, at the depth closest to its center
+				float offset = depth < sliceNear ? sliceNear - depth : (depth > sliceFar ? depth - sliceFar : 0.0f);
+				float sectionRadius = sqrtf(std::max(radius * radius - offset * offset, 0.0f));
+
+				// Projects the box around that cross-section over the slice's depths; x / depth is
+				// smallest at the far end for positive x and at the near end for negative x
+				float x0 = center.x - sectionRadius;
+				float x1 = center.x + sectionRadius;
+				float y0 = center.y - sectionRadius;
+				float y1 = center.y + sectionRadius;
+				float left = (x0 >= 0.0f ? x0 / sliceFar : x0 / sliceNear) / tanX;
+				float right = (x1 >= 0.0f ? x1 / sliceNear : x1 / sliceFar) / tanX;
+				float bottom = (y0 >= 0.0f ? y0 / sliceFar : y0 / sliceNear) / tanY;
+				float top = (y1 >= 0.0f ? y1 / sliceNear : y1 / sliceFar) / tanY;
+				if (right < -1.0f || left > 1.0f || top < -1.0f || bottom > 1.0f) {
+					continue;
+				}
+
+				ClusterRect rect;
+				rect.visibleLight = visibleLight;
+				rect.slice = (uint16_t)slice;
+				rect.x0 = (uint8_t)std::min(std::max((int)floorf((left * 0.5f + 0.5f) * CLUSTER_TILES_X), 0), CLUSTER_TILES_X - 1);
+				rect.x1 = (uint8_t)std::min(std::max((int)floorf((right * 0.5f + 0.5f) * CLUSTER_TILES_X), 0), CLUSTER_TILES_X - 1);
+				rect.y0 = (uint8_t)std::min(std::max((int)floorf((bottom * 0.5f + 0.5f) * CLUSTER_TILES_Y), 0), CLUSTER_TILES_Y - 1);
+				rect.y1 = (uint8_t)std::min(std::max((int)floorf((top * 0.5f + 0.5f) * CLUSTER_TILES_Y), 0), CLUSTER_TILES_Y - 1);
+				rects.push_back(rect);
+			}
+		}
+
+		// Counts the lights of every cluster, turns the counts into offsets, then fills the
+		// index list, counting again
+		std::fill(clusterRanges.begin(), clusterRanges.end(), 0);
+		for (size_t i = 0; i < rects.size(); i++) {
+			const ClusterRect& rect = rects[i];
+			for (int y = rect.y0; y <= rect.y1; y++) {
+				for (int x = rect.x0; x <= rect.x1; x++) {
+					clusterRanges[2 * ((rect.slice * CLUSTER_TILES_Y + y) * CLUSTER_TILES_X + x) + 1]++;
+				}
+			}
+		}
+		uint32_t offset = 0;
+		for (int cluster = 0; cluster < CLUSTER_COUNT; cluster++) {
+			clusterRanges[2 * cluster] = offset;
+			offset += clusterRanges[2 * cluster + 1];
+			clusterRanges[2 * cluster + 1] = 0;
+		}
+		indices.resize(offset);
+		for (size_t i = 0; i < rects.size(); i++) {
+			const ClusterRect& rect = rects[i];
+			for (int y = rect.y0; y <= rect.y1; y++) {
+				for (int x = rect.x0; x <= rect.x1; x++) {
+					uint32_t* range = &clusterRanges[2 * ((rect.slice * CLUSTER_TILES_Y + y) * CLUSTER_TILES_X + x)];
+					indices[range[0] + range[1]++] = rect.visibleLight;
+				}
+			}
+		}
+
+		upload(lightBuffer, lightTexture, GL_RGBA32F, lightData.data(), lightData.size() * sizeof(float), &lightBufferSize);
+		upload(rangeBuffer, rangeTexture, GL_RG32UI, clusterRanges.data(), clusterRanges.size() * sizeof(uint32_t), &rangeBufferSize);
+		upload(indexBuffer, indexTexture, GL_R32UI, indices.data(), indices.size() * sizeof(uint32_t), &indexBufferSize);
+	}
+
+	void ClusteredLights::upload(gps::BufferHandle& buffer, gps::TextureHandle& texture, GLenum format, const void* data, size_t bytes, size_t* capacity) {
+		glBindBuffer(GL_TEXTURE_BUFFER, buffer.get());
+		if (bytes > *capacity || *capacity == 0) {
+			*capacity = std::max(std::max(bytes, 2 * *capacity), (size_t)256);
+			glBufferData(GL_TEXTURE_BUFFER, *capacity, NULL, GL_STREAM_DRAW);
+			GLState::getInstance().bindTexture(0, GL_TEXTURE_BUFFER, texture.get());
+			glTexBuffer(GL_TEXTURE_BUFFER, format, buffer.get());
+		}
+		else {
+			// Orphans last frame's data instead of waiting for the draws still reading it
+			glBufferData(GL_TEXTURE_BUFFER, *capacity, NULL, GL_STREAM_DRAW);
+		}
+		if (bytes > 0) {
+			glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, data);
+		}
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	}
+
+	void ClusteredLights::setUniforms(gps::Shader& shader, GLuint textureUnit) const {
+		GLState& state = GLState::getInstance();
+		state.bindTexture(textureUnit, GL_TEXTURE_BUFFER, lightTexture.get());
+		state.bindTexture(textureUnit + 1, GL_TEXTURE_BUFFER, rangeTexture.get());
+		state.bindTexture(textureUnit + 2, GL_TEXTURE_BUFFER, indexTexture.get());
+		shader.setInt("clusterLights", (GLint)textureUnit);
+		shader.setInt("clusterRanges", (GLint)textureUnit + 1);
+		shader.setInt("clusterIndices", (GLint)textureUnit + 2);
+		shader.setVec2("clusterTileScale", tileScale);
+		shader.setFloat("clusterSliceScale", sliceScale);
+		shader.setFloat("clusterSliceBias", sliceBias);
+	}
+
+	size_t ClusteredLights::getVisibleLightCount() const {
+		return lightData.size() / LIGHT_FLOATS;
+	}
+
+	size_t ClusteredLights::getAssignmentCount() const {
+		return indices.size();
+	}
+}
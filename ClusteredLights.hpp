@@ -0,0 +1,102 @@
+#ifndef ClusteredLights_hpp
+#define ClusteredLights_hpp
+
+#include <GL/glew.h>
+#include "glm/glm.hpp"
+
+#include "GLHandle.hpp"
+#include "Shader.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace gps {
+
+    // Cluster grid: screen tiles by depth slices, the slices growing exponentially with the
+    // distance so clusters stay roughly cubic. Must match shaders/lighting.glsl
+    const int CLUSTER_TILES_X = 16;
+    const int CLUSTER_TILES_Y = 9;
+    const int CLUSTER_SLICES = 24;
+    const int CLUSTER_COUNT = CLUSTER_TILES_X * CLUSTER_TILES_Y * CLUSTER_SLICES;
+
+    struct PointLight {
+        // World space
+        glm::vec3 position;
+        float radius;
+        glm::vec3 color;
+        // Cube in the PointShadowMap, or -1
+        int32_t shadow;
+    };
+
+    // Any number of point lights for forward shading. Every frame the lights that reach the view
+    // are assigned on the CPU to the clusters their sphere overlaps, and three texture buffers are
+    // uploaded: the lights (view space position and radius, color and shadow cube), the range of
+    // each cluster in the index list, and the index list. A fragment only loops over the lights
+    // of its cluster
+    class ClusteredLights
+    {
+    public:
+        ClusteredLights();
+
+        void init();
+        // Deletes the buffers and textures; call while the context still exists
+        void reset();
+
+        // Returns the light's index
+        uint32_t addLight(const gps::PointLight& light);
+        void setLightPosition(uint32_t light, const glm::vec3& position);
+        size_t getLightCount() const;
+
+        // Assigns the lights to the clusters of a perspective view of the given vertical field
+        // of view (radians), planes and viewport size, and uploads the result
+        void update(const glm::mat4& view, float fovy, float aspect, float nearPlane, float farPlane, int width, int height);
+
+        // Binds the buffers to textureUnit and the two units after it, and sets clusterLights,
+        // clusterRanges, clusterIndices and the grid uniforms
+        void setUniforms(gps::Shader& shader, GLuint textureUnit) const;
+
+        // Of the last update: lights that reach the view, and light-cluster pairs
+        size_t getVisibleLightCount() const;
+        size_t getAssignmentCount() const;
+
+    private:
+        // A light's tiles in one slice, inclusive
+        struct ClusterRect {
+            // Index among the visible lights
+            uint32_t visibleLight;
+            uint16_t slice;
+            uint8_t x0, x1, y0, y1;
+        };
+
+        std::vector<gps::PointLight> lights;
+
+        // Rebuilt every update; their capacity is kept
+        // Two RGBA texels per visible light
+        std::vector<float> lightData;
+        std::vector<ClusterRect> rects;
+        std::vector<uint32_t> clusterRanges;
+        std::vector<uint32_t> indices;
+
+        gps::BufferHandle lightBuffer;
+        gps::BufferHandle rangeBuffer;
+        gps::BufferHandle indexBuffer;
+        gps::TextureHandle lightTexture;
+        gps::TextureHandle rangeTexture;
+        gps::TextureHandle indexTexture;
+        // Bytes allocated in each buffer; they only grow
+        size_t lightBufferSize;
+        size_t rangeBufferSize;
+        size_t indexBufferSize;
+
+        // Pixels to tiles
+        glm::vec2 tileScale;
+        float sliceScale;
+        float sliceBias;
+
+        // Grows the buffer (and re-attaches it to its texture) if the data does not fit
+        void upload(gps::BufferHandle& buffer, gps::TextureHandle& texture, GLenum format, const void* data, size_t bytes, size_t* capacity);
+    };
+}
+
+#endif /* ClusteredLights_hpp */
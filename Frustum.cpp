@@ -0,0 +1,113 @@
+#include "Frustum.hpp"
+#include "Simd.hpp"
+
+namespace gps {
+
+	Frustum::Frustum() {
+		// Zero planes put every point on the boundary, so nothing is outside
+		for (int p = 0; p < PLANE_COUNT; p++) {
+			planes[p] = glm::vec4(0.0f);
+		}
+	}
+
+	Frustum::Frustum(const glm::mat4& viewProjection) {
+		// glm is column-major, so row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+		glm::vec4 rows[4];
+		for (int i = 0; i < 4; i++) {
+			rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+		}
+
+		planes[PLANE_LEFT] = rows[3] + rows[0];
+		planes[PLANE_RIGHT] = rows[3] - rows[0];
+		planes[PLANE_BOTTOM] = rows[3] + rows[1];
+		planes[PLANE_TOP] = rows[3] - rows[1];
+		planes[PLANE_NEAR] = rows[3] + rows[2];
+		planes[PLANE_FAR] = rows[3] - rows[2];
+
+		// Unit normals make the plane distances comparable to radii
+		for (int p = 0; p < PLANE_COUNT; p++) {
+			planes[p] = planes[p] / glm::length(glm::vec3(planes[p]));
+		}
+	}
+
+	const glm::vec4& Frustum::getPlane(FRUSTUM_PLANE plane) const {
+		return planes[plane];
+	}
+
+	void Frustum::ignorePlane(FRUSTUM_PLANE plane) {
+		planes[plane] = glm::vec4(0.0f);
+	}
+
+	bool Frustum::intersects(const gps::BoundingSphere& sphere) const {
+		for (int p = 0; p < PLANE_COUNT; p++) {
+			if (glm::dot(glm::vec3(planes[p]), sphere.center) + planes[p].w < -sphere.radius) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool Frustum::intersects(const gps::BoundingBox& box) const {
+		for (int p = 0; p < PLANE_COUNT; p++) {
+			// The box corner furthest along the plane normal
+			glm::vec3 corner(planes[p].x >= 0.0f ? box.max.x : box.min.x,
+				planes[p].y >= 0.0f ? box.max.y : box.min.y,
+				planes[p].z >= 0.0f ? box.max.z : box.min.z);
+			if (glm::dot(glm::vec3(planes[p]), corner) + planes[p].w < 0.0f) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool Frustum::contains(const gps::BoundingBox& box) const {
+		for (int p = 0; p < PLANE_COUNT; p++) {
+			// The box corner furthest against the plane normal
+			glm::vec3 corner(planes[p].x >= 0.0f ? box.min.x : box.max.x,
+				planes[p].y >= 0.0f ? box.min.y : box.max.y,
+				planes[p].z >= 0.0f ? box.min.z : box.max.z);
+			if (glm::dot(glm::vec3(planes[p]), corner) + planes[p].w < 0.0f) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	size_t Frustum::cullSpheres(const float* x, const float* y, const float* z, const float* radius, size_t count, uint8_t* visible) const {
+		size_t visibleCount = 0;
+
+#ifdef GPS_SSE
+		for (size_t i = 0; i < count; i += SIMD_LANES) {
+			__m128 cx = _mm_loadu_ps(x + i);
+			__m128 cy = _mm_loadu_ps(y + i);
+			__m128 cz = _mm_loadu_ps(z + i);
+			__m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+
+			// All ones in the lanes whose sphere is not fully behind any plane
+			__m128 inside = _mm_cmpeq_ps(cx, cx);
+			for (int p = 0; p < PLANE_COUNT; p++) {
+				__m128 distance = _mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(planes[p].x)), _mm_set1_ps(planes[p].w));
+				distance = _mm_add_ps(distance, _mm_mul_ps(cy, _mm_set1_ps(planes[p].y)));
+				distance = _mm_add_ps(distance, _mm_mul_ps(cz, _mm_set1_ps(planes[p].z)));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+			}
+
+			int mask = _mm_movemask_ps(inside);
+			for (size_t lane = 0; lane < SIMD_LANES && i + lane < count; lane++) {
+				visible[i + lane] = (uint8_t)((mask >> lane) & 1);
+				visibleCount += visible[i + lane];
+			}
+		}
+#else
+		for (size_t i = 0; i < count; i++) {
+			gps::BoundingSphere sphere;
+			sphere.center = glm::vec3(x[i], y[i], z[i]);
+			sphere.radius = radius[i];
+			visible[i] = intersects(sphere) ? 1 : 0;
+			visibleCount += visible[i];
+		}
+#endif
+
+		return visibleCount;
+	}
+}
@@ -0,0 +1,46 @@
+#ifndef Frustum_hpp
+#define Frustum_hpp
+
+#include "Mesh.hpp"
+
+#include "glm/glm.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace gps {
+
+    enum FRUSTUM_PLANE {PLANE_LEFT, PLANE_RIGHT, PLANE_BOTTOM, PLANE_TOP, PLANE_NEAR, PLANE_FAR, PLANE_COUNT};
+
+    // The planes of a projection * view matrix, normalized and facing inwards: a point p is
+    // inside when dot(plane, vec4(p, 1)) >= 0 for every plane
+    class Frustum
+    {
+    public:
+        // Contains everything
+        Frustum();
+        // Extracts the planes from the rows of the matrix (Gribb & Hartmann)
+        explicit Frustum(const glm::mat4& viewProjection);
+
+        const glm::vec4& getPlane(FRUSTUM_PLANE plane) const;
+
+        // Stops testing against one plane, extending the volume without bound on that side
+        void ignorePlane(FRUSTUM_PLANE plane);
+
+        // Conservative tests: shapes near a corner of the frustum may pass while outside it
+        bool intersects(const gps::BoundingSphere& sphere) const;
+        bool intersects(const gps::BoundingBox& box) const;
+        // True if the whole box is inside
+        bool contains(const gps::BoundingBox& box) const;
+
+        // Tests count spheres given as separate center x/y/z and radius arrays, padded to a
+        // multiple of SIMD_LANES, four at a time. visible[i] is set to 1 for the spheres that
+        // intersect and 0 for the others; returns how many intersect
+        size_t cullSpheres(const float* x, const float* y, const float* z, const float* radius, size_t count, uint8_t* visible) const;
+
+    private:
+        glm::vec4 planes[PLANE_COUNT];
+    };
+}
+
+#endif /* Frustum_hpp */
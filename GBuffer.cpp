@@ -0,0 +1,102 @@
+#include "GBuffer.hpp"
+#include "GLState.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace gps {
+
+	const char* getRenderPathName(RENDER_PATH path) {
+		static const char* names[RENDER_PATH_COUNT] = {"forward", "deferred"};
+		return path >= 0 && path < RENDER_PATH_COUNT ? names[path] : "unknown";
+	}
+
+	GBuffer::GBuffer() : width(0), height(0) {
+	}
+
+	void GBuffer::init(GLsizei bufferWidth, GLsizei bufferHeight) {
+		GLuint framebufferId;
+		GLuint textureIds[4];
+		glGenFramebuffers(1, &framebufferId);
+		glGenTextures(4, textureIds);
+		framebuffer.reset(framebufferId);
+		albedo.reset(textureIds[0]);
+		normal.reset(textureIds[1]);
+		specular.reset(textureIds[2]);
+		depth.reset(textureIds[3]);
+
+		width = std::max(bufferWidth, (GLsizei)1);
+		height = std::max(bufferHeight, (GLsizei)1);
+		allocate();
+
+		GLState& state = GLState::getInstance();
+		state.bindFramebuffer(framebuffer.get());
+		glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, albedo.get(), 0);
+		glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, normal.get(), 0);
+		glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, specular.get(), 0);
+		glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depth.get(), 0);
+		const GLenum drawBuffers[3] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2};
+		glDrawBuffers(3, drawBuffers);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			fprintf(stderr, "ERROR: G-buffer framebuffer is incomplete\n");
+		}
+		state.bindFramebuffer(0);
+	}
+
+	void GBuffer::reset() {
+		framebuffer.reset();
+		albedo.reset();
+		normal.reset();
+		specular.reset();
+		depth.reset();
+	}
+
+	void GBuffer::resize(GLsizei bufferWidth, GLsizei bufferHeight) {
+		bufferWidth = std::max(bufferWidth, (GLsizei)1);
+		bufferHeight = std::max(bufferHeight, (GLsizei)1);
+		if (bufferWidth != width || bufferHeight != height) {
+			width = bufferWidth;
+			height = bufferHeight;
+			allocate();
+		}
+	}
+
+	void GBuffer::allocate() {
+		// Internal format, format and type of each attachment; the normals need more than 8 bits
+		const GLuint textures[4] = {albedo.get(), normal.get(), specular.get(), depth.get()};
+		const GLenum internalFormats[4] = {GL_SRGB8_ALPHA8, GL_RGBA16F, GL_SRGB8_ALPHA8, GL_DEPTH_COMPONENT24};
+		const GLenum formats[4] = {GL_RGBA, GL_RGBA, GL_RGBA, GL_DEPTH_COMPONENT};
+		const GLenum types[4] = {GL_UNSIGNED_BYTE, GL_HALF_FLOAT, GL_UNSIGNED_BYTE, GL_FLOAT};
+
+		GLState& state = GLState::getInstance();
+		for (int i = 0; i < 4; i++) {
+			state.bindTexture(0, GL_TEXTURE_2D, textures[i]);
+			glTexImage2D(GL_TEXTURE_2D, 0, internalFormats[i], width, height, 0, formats[i], types[i], NULL);
+			// Read texel for pixel
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		}
+		state.bindTexture(0, GL_TEXTURE_2D, 0);
+	}
+
+	void GBuffer::begin() {
+		GLState& state = GLState::getInstance();
+		state.bindFramebuffer(framebuffer.get());
+		state.viewport(0, 0, width, height);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	}
+
+	void GBuffer::setUniforms(gps::Shader& shader, GLuint textureUnit) const {
+		GLState& state = GLState::getInstance();
+		state.bindTexture(textureUnit, GL_TEXTURE_2D, albedo.get());
+		state.bindTexture(textureUnit + 1, GL_TEXTURE_2D, normal.get());
+		state.bindTexture(textureUnit + 2, GL_TEXTURE_2D, specular.get());
+		state.bindTexture(textureUnit + 3, GL_TEXTURE_2D, depth.get());
+		shader.setInt("gAlbedo", (GLint)textureUnit);
+		shader.setInt("gNormal", (GLint)textureUnit + 1);
+		shader.setInt("gSpecular", (GLint)textureUnit + 2);
+		shader.setInt("gDepth", (GLint)textureUnit + 3);
+	}
+}
@@ -0,0 +1,52 @@
+#ifndef GBuffer_hpp
+#define GBuffer_hpp
+
+#include <GL/glew.h>
+
+#include "GLHandle.hpp"
+#include "Shader.hpp"
+
+namespace gps {
+
+    // PATH_FORWARD lights every fragment as it is drawn (shaderStart). PATH_DEFERRED draws the
+    // surfaces into a GBuffer first and lights each pixel once, from the G-buffer
+    enum RENDER_PATH {PATH_FORWARD, PATH_DEFERRED, RENDER_PATH_COUNT};
+
+    // Short name of the path, for reports and the command line
+    const char* getRenderPathName(RENDER_PATH path);
+
+    // Surfaces of the deferred path, the size of the window: albedo, eye space normal and
+    // specular color in three color attachments and the depth in a texture. Albedo and specular
+    // are sRGB, like the textures they come from
+    class GBuffer
+    {
+    public:
+        GBuffer();
+
+        void init(GLsizei width, GLsizei height);
+        // Deletes the textures and framebuffer; call while the context still exists
+        void reset();
+        // Reallocates the attachments if the size changed
+        void resize(GLsizei width, GLsizei height);
+
+        // Binds the framebuffer and its viewport and clears it; the surfaces are drawn next
+        void begin();
+
+        // Binds albedo, normal, specular and depth to textureUnit and the three units after it,
+        // and sets gAlbedo, gNormal, gSpecular and gDepth
+        void setUniforms(gps::Shader& shader, GLuint textureUnit) const;
+
+    private:
+        gps::FramebufferHandle framebuffer;
+        gps::TextureHandle albedo;
+        gps::TextureHandle normal;
+        gps::TextureHandle specular;
+        gps::TextureHandle depth;
+        GLsizei width;
+        GLsizei height;
+
+        void allocate();
+    };
+}
+
+#endif /* GBuffer_hpp */
@@ -0,0 +1,90 @@
+#ifndef GLHandle_hpp
+#define GLHandle_hpp
+
+#include <GL/glew.h>
+
+#include "GLState.hpp"
+
+namespace gps {
+
+    // Owns one OpenGL object name and deletes it when destroyed. It can be moved but not
+    // copied, so each object has a single owner and is deleted exactly once
+    template <typename Deleter>
+    class GLHandle
+    {
+    public:
+        GLHandle() : id(0) {}
+        explicit GLHandle(GLuint id) : id(id) {}
+        ~GLHandle() { reset(); }
+
+        GLHandle(const GLHandle&) = delete;
+        GLHandle& operator=(const GLHandle&) = delete;
+
+        GLHandle(GLHandle&& other) noexcept : id(other.release()) {}
+
+        GLHandle& operator=(GLHandle&& other) noexcept {
+            if (this != &other) {
+                reset(other.release());
+            }
+            return *this;
+        }
+
+        GLuint get() const { return id; }
+
+        // Deletes the current object, if any, and takes ownership of newId
+        void reset(GLuint newId = 0) {
+            if (id != 0) {
+                Deleter()(id);
+            }
+            id = newId;
+        }
+
+        // Gives up ownership without deleting the object
+        GLuint release() {
+            GLuint oldId = id;
+            id = 0;
+            return oldId;
+        }
+
+    private:
+        GLuint id;
+    };
+
+    struct ProgramDeleter {
+        void operator()(GLuint id) const { GLState::getInstance().programDeleted(id); glDeleteProgram(id); }
+    };
+
+    struct BufferDeleter {
+        void operator()(GLuint id) const { glDeleteBuffers(1, &id); }
+    };
+
+    struct VertexArrayDeleter {
+        void operator()(GLuint id) const { GLState::getInstance().vertexArrayDeleted(id); glDeleteVertexArrays(1, &id); }
+    };
+
+    struct FramebufferDeleter {
+        void operator()(GLuint id) const { GLState::getInstance().framebufferDeleted(id); glDeleteFramebuffers(1, &id); }
+    };
+
+    struct TextureDeleter {
+        void operator()(GLuint id) const { GLState::getInstance().textureDeleted(id); glDeleteTextures(1, &id); }
+    };
+
+    struct SamplerDeleter {
+        void operator()(GLuint id) const { glDeleteSamplers(1, &id); }
+    };
+
+    struct QueryDeleter {
+        void operator()(GLuint id) const { glDeleteQueries(1, &id); }
+    };
+
+    typedef GLHandle<ProgramDeleter> ProgramHandle;
+    typedef GLHandle<BufferDeleter> BufferHandle;
+    typedef GLHandle<VertexArrayDeleter> VertexArrayHandle;
+    typedef GLHandle<FramebufferDeleter> FramebufferHandle;
+    typedef GLHandle<TextureDeleter> TextureHandle;
+    typedef GLHandle<SamplerDeleter> SamplerHandle;
+    typedef GLHandle<QueryDeleter> QueryHandle;
+}
+
+#endif /* GLHandle_hpp */
@@ -0,0 +1,183 @@
+#include "GLState.hpp"
+
+#include <cstdio>
+
+namespace gps {
+
+	static const char* STATE_CALL_NAMES[STATE_CALL_COUNT] = {
+		"glUseProgram", "glBindVertexArray", "glActiveTexture", "glBindTexture",
+		"glBindFramebuffer", "glViewport", "glDepthFunc"
+	};
+
+	// Index of a texture target in the per-unit bindings, or -1 if it is not tracked
+	static int textureTargetIndex(GLenum target) {
+		switch (target) {
+			case GL_TEXTURE_2D:
+				return 0;
+			case GL_TEXTURE_CUBE_MAP:
+				return 1;
+			case GL_TEXTURE_2D_ARRAY:
+				return 2;
+			case GL_TEXTURE_CUBE_MAP_ARRAY:
+				return 3;
+			case GL_TEXTURE_BUFFER:
+				return 4;
+			default:
+				return -1;
+		}
+	}
+
+	GLState::GLState() {
+		// Nothing is known about the context yet, so the first call of each kind always goes through
+		program = UNKNOWN;
+		vertexArray = UNKNOWN;
+		activeUnit = UNKNOWN;
+		for (GLuint unit = 0; unit < MAX_TEXTURE_UNITS; unit++) {
+			for (GLuint target = 0; target < TEXTURE_TARGET_COUNT; target++) {
+				textures[unit][target] = UNKNOWN;
+			}
+		}
+		framebuffer = UNKNOWN;
+		for (int i = 0; i < 4; i++) {
+			viewportRect[i] = -1;
+		}
+		depthFunction = 0;
+
+		resetStats();
+	}
+
+	GLState& GLState::getInstance() {
+		// Never destroyed: the global models and handles delete their objects during static destruction
+		static GLState* instance = new GLState();
+		return *instance;
+	}
+
+	bool GLState::change(STATE_CALL call, bool redundant) {
+		if (redundant) {
+			skipped[call]++;
+			return false;
+		}
+		issued[call]++;
+		return true;
+	}
+
+	void GLState::useProgram(GLuint program) {
+		if (change(STATE_PROGRAM, this->program == program)) {
+			glUseProgram(program);
+			this->program = program;
+		}
+	}
+
+	void GLState::bindVertexArray(GLuint vertexArray) {
+		if (change(STATE_VERTEX_ARRAY, this->vertexArray == vertexArray)) {
+			glBindVertexArray(vertexArray);
+			this->vertexArray = vertexArray;
+		}
+	}
+
+	void GLState::activeTexture(GLuint unit) {
+		if (change(STATE_ACTIVE_TEXTURE, activeUnit == unit)) {
+			glActiveTexture(GL_TEXTURE0 + unit);
+			activeUnit = unit;
+		}
+	}
+
+	void GLState::bindTexture(GLuint unit, GLenum target, GLuint texture) {
+		int targetIndex = textureTargetIndex(target);
+		bool tracked = targetIndex >= 0 && unit < MAX_TEXTURE_UNITS;
+
+		if (change(STATE_TEXTURE, tracked && textures[unit][targetIndex] == texture)) {
+			activeTexture(unit);
+			glBindTexture(target, texture);
+			if (tracked) {
+				textures[unit][targetIndex] = texture;
+			}
+		}
+	}
+
+	void GLState::bindFramebuffer(GLuint framebuffer) {
+		if (change(STATE_FRAMEBUFFER, this->framebuffer == framebuffer)) {
+			glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+			this->framebuffer = framebuffer;
+		}
+	}
+
+	void GLState::viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+		bool redundant = viewportRect[0] == x && viewportRect[1] == y && viewportRect[2] == width && viewportRect[3] == height;
+		if (change(STATE_VIEWPORT, redundant)) {
+			glViewport(x, y, width, height);
+			viewportRect[0] = x;
+			viewportRect[1] = y;
+			viewportRect[2] = width;
+			viewportRect[3] = height;
+		}
+	}
+
+	void GLState::depthFunc(GLenum func) {
+		if (change(STATE_DEPTH_FUNC, depthFunction == func)) {
+			glDepthFunc(func);
+			depthFunction = func;
+		}
+	}
+
+	// A deleted program stays in use until another one replaces it, so its name is only forgotten
+	void GLState::programDeleted(GLuint program) {
+		if (this->program == program) {
+			this->program = UNKNOWN;
+		}
+	}
+
+	void GLState::vertexArrayDeleted(GLuint vertexArray) {
+		if (this->vertexArray == vertexArray) {
+			this->vertexArray = UNKNOWN;
+		}
+	}
+
+	void GLState::textureDeleted(GLuint texture) {
+		for (GLuint unit = 0; unit < MAX_TEXTURE_UNITS; unit++) {
+			for (GLuint target = 0; target < TEXTURE_TARGET_COUNT; target++) {
+				if (textures[unit][target] == texture) {
+					textures[unit][target] = UNKNOWN;
+				}
+			}
+		}
+	}
+
+	void GLState::framebufferDeleted(GLuint framebuffer) {
+		if (this->framebuffer == framebuffer) {
+			this->framebuffer = UNKNOWN;
+		}
+	}
+
+	size_t GLState::getIssuedCount(STATE_CALL call) {
+		return issued[call];
+	}
+
+	size_t GLState::getSkippedCount(STATE_CALL call) {
+		return skipped[call];
+	}
+
+	void GLState::resetStats() {
+		for (int i = 0; i < STATE_CALL_COUNT; i++) {
+			issued[i] = 0;
+			skipped[i] = 0;
+		}
+	}
+
+	void GLState::printStats(size_t frames) {
+		if (frames == 0) {
+			return;
+		}
+
+		size_t totalIssued = 0;
+		size_t totalSkipped = 0;
+		for (int i = 0; i < STATE_CALL_COUNT; i++) {
+			printf("GL state       : %-18s %8.1f issued %8.1f skipped per frame\n",
+				STATE_CALL_NAMES[i], (double)issued[i] / frames, (double)skipped[i] / frames);
+			totalIssued += issued[i];
+			totalSkipped += skipped[i];
+		}
+		printf("GL state       : %-18s %8.1f issued %8.1f skipped per frame\n",
+			"total", (double)totalIssued / frames, (double)totalSkipped / frames);
+	}
+}
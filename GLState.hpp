@@ -0,0 +1,70 @@
+#ifndef GLState_hpp
+#define GLState_hpp
+
+#include <GL/glew.h>
+
+#include <cstddef>
+
+namespace gps {
+
+    // Kinds of state calls GLState tracks; used to index its counters
+    enum STATE_CALL {STATE_PROGRAM, STATE_VERTEX_ARRAY, STATE_ACTIVE_TEXTURE, STATE_TEXTURE,
+        STATE_FRAMEBUFFER, STATE_VIEWPORT, STATE_DEPTH_FUNC, STATE_CALL_COUNT};
+
+    // Shadows the OpenGL state the renderer changes most and drops calls that would set it
+    // to the value it already has. Every change to the tracked state has to go through here,
+    // otherwise the shadow copy goes stale; objects must be deleted through the *Deleted
+    // functions (GLHandle and TextureCache do this), since their names can be reused
+    class GLState
+    {
+    public:
+        static GLState& getInstance();
+
+        void useProgram(GLuint program);
+        void bindVertexArray(GLuint vertexArray);
+        void activeTexture(GLuint unit);
+        // Makes the unit active and binds the texture to it
+        void bindTexture(GLuint unit, GLenum target, GLuint texture);
+        void bindFramebuffer(GLuint framebuffer);
+        void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+        void depthFunc(GLenum func);
+
+        // Forget any binding of a deleted object, so a new object reusing the name is bound again
+        void programDeleted(GLuint program);
+        void vertexArrayDeleted(GLuint vertexArray);
+        void textureDeleted(GLuint texture);
+        void framebufferDeleted(GLuint framebuffer);
+
+        // Counts of the calls passed to OpenGL and of those dropped as redundant
+        size_t getIssuedCount(STATE_CALL call);
+        size_t getSkippedCount(STATE_CALL call);
+        void resetStats();
+
+        // Average issued/skipped calls per frame over the given number of frames
+        void printStats(size_t frames);
+
+    private:
+        static const GLuint UNKNOWN = 0xFFFFFFFFu;
+        static const GLuint MAX_TEXTURE_UNITS = 16;
+        // 2D, cube map, 2D array, cube map array, buffer
+        static const GLuint TEXTURE_TARGET_COUNT = 5;
+
+        GLuint program;
+        GLuint vertexArray;
+        GLuint activeUnit;
+        GLuint textures[MAX_TEXTURE_UNITS][TEXTURE_TARGET_COUNT];
+        GLuint framebuffer;
+        GLint viewportRect[4];
+        GLenum depthFunction;
+
+        size_t issued[STATE_CALL_COUNT];
+        size_t skipped[STATE_CALL_COUNT];
+
+        GLState();
+
+        // Returns false (and counts the call as skipped) if the state already has the value
+        bool change(STATE_CALL call, bool redundant);
+    };
+}
+
+#endif /* GLState_hpp */
@@ -0,0 +1,176 @@
+#include "GeometryArena.hpp"
+#include "GLState.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+
+namespace gps {
+
+	// Initial sizes, doubled whenever an allocation does not fit
+	const GLuint ARENA_INITIAL_VERTICES = 1 << 18;
+	const GLuint ARENA_INITIAL_INDICES = 1 << 20;
+
+	RangeAllocator::RangeAllocator() {
+		capacity = 0;
+	}
+
+	bool RangeAllocator::allocate(GLuint count, GLuint* offset) {
+		for (auto range = freeRanges.begin(); range != freeRanges.end(); ++range) {
+			if (range->second < count) {
+				continue;
+			}
+
+			*offset = range->first;
+			GLuint remaining = range->second - count;
+			freeRanges.erase(range);
+			if (remaining > 0) {
+				freeRanges[*offset + count] = remaining;
+			}
+			return true;
+		}
+		return false;
+	}
+
+	void RangeAllocator::release(GLuint offset, GLuint count) {
+		auto next = freeRanges.lower_bound(offset);
+
+		// Merge with the free range right after
+		if (next != freeRanges.end() && offset + count == next->first) {
+			count += next->second;
+			next = freeRanges.erase(next);
+		}
+
+		// Merge with the free range right before
+		if (next != freeRanges.begin()) {
+			auto previous = std::prev(next);
+			if (previous->first + previous->second == offset) {
+				previous->second += count;
+				return;
+			}
+		}
+
+		freeRanges[offset] = count;
+	}
+
+	void RangeAllocator::grow(GLuint newCapacity) {
+		GLuint oldCapacity = capacity;
+		capacity = newCapacity;
+		release(oldCapacity, newCapacity - oldCapacity);
+	}
+
+	GLuint RangeAllocator::getCapacity() {
+		return capacity;
+	}
+
+	GeometryArena::GeometryArena() {
+		vertexAllocator.grow(ARENA_INITIAL_VERTICES);
+		indexAllocator.grow(ARENA_INITIAL_INDICES);
+
+		glGenVertexArrays(1, &VAO);
+		glGenBuffers(1, &VBO);
+		glGenBuffers(1, &EBO);
+
+		// The copy targets leave the bound VAO's element buffer alone
+		glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+		glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)ARENA_INITIAL_VERTICES * sizeof(Vertex), NULL, GL_STATIC_DRAW);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+		glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)ARENA_INITIAL_INDICES * sizeof(GLuint), NULL, GL_STATIC_DRAW);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+		setupVertexArray();
+	}
+
+	GeometryArena& GeometryArena::getInstance() {
+		// Created on first use, once the OpenGL context exists; never destroyed, since the global models release their ranges during static destruction
+		static GeometryArena* instance = new GeometryArena();
+		return *instance;
+	}
+
+	GeometryRange GeometryArena::allocate(const Vertex* vertices, GLsizei vertexCount, const GLuint* indices, GLsizei indexCount) {
+		GeometryRange range;
+		range.baseVertex = 0;
+		range.vertexCount = vertexCount;
+		range.firstIndex = 0;
+		range.indexCount = indexCount;
+
+		if (vertexCount > 0) {
+			GLuint offset;
+			while (!vertexAllocator.allocate((GLuint)vertexCount, &offset)) {
+				GLuint oldCapacity = vertexAllocator.getCapacity();
+				GLuint newCapacity = std::max(oldCapacity * 2, oldCapacity + (GLuint)vertexCount);
+				VBO = growBuffer(VBO, (GLsizeiptr)oldCapacity * sizeof(Vertex), (GLsizeiptr)newCapacity * sizeof(Vertex));
+				vertexAllocator.grow(newCapacity);
+				setupVertexArray();
+			}
+			range.baseVertex = (GLint)offset;
+
+			glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+			glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)offset * sizeof(Vertex), (GLsizeiptr)vertexCount * sizeof(Vertex), vertices);
+		}
+
+		if (indexCount > 0) {
+			GLuint offset;
+			while (!indexAllocator.allocate((GLuint)indexCount, &offset)) {
+				GLuint oldCapacity = indexAllocator.getCapacity();
+				GLuint newCapacity = std::max(oldCapacity * 2, oldCapacity + (GLuint)indexCount);
+				EBO = growBuffer(EBO, (GLsizeiptr)oldCapacity * sizeof(GLuint), (GLsizeiptr)newCapacity * sizeof(GLuint));
+				indexAllocator.grow(newCapacity);
+				setupVertexArray();
+			}
+			range.firstIndex = offset;
+
+			glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+			glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)offset * sizeof(GLuint), (GLsizeiptr)indexCount * sizeof(GLuint), indices);
+		}
+
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		return range;
+	}
+
+	void GeometryArena::release(GeometryRange range) {
+		if (range.vertexCount > 0) {
+			vertexAllocator.release((GLuint)range.baseVertex, (GLuint)range.vertexCount);
+		}
+		if (range.indexCount > 0) {
+			indexAllocator.release(range.firstIndex, (GLuint)range.indexCount);
+		}
+	}
+
+	void GeometryArena::bind() {
+		GLState::getInstance().bindVertexArray(VAO);
+	}
+
+	GLuint GeometryArena::growBuffer(GLuint buffer, GLsizeiptr oldSize, GLsizeiptr newSize) {
+		GLuint newBuffer;
+		glGenBuffers(1, &newBuffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, newSize, NULL, GL_STATIC_DRAW);
+
+		glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldSize);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+		glDeleteBuffers(1, &buffer);
+		return newBuffer;
+	}
+
+	void GeometryArena::setupVertexArray() {
+		GLState::getInstance().bindVertexArray(VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
+		// Vertex Positions
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)0);
+		// Vertex Normals
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, Normal));
+		// Vertex Texture Coords
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, TexCoords));
+
+		GLState::getInstance().bindVertexArray(0);
+	}
+}
@@ -0,0 +1,66 @@
+#ifndef GeometryArena_hpp
+#define GeometryArena_hpp
+
+#include "Mesh.hpp"
+
+#include <map>
+
+namespace gps {
+
+    // First-fit allocator over [0, capacity) elements; released ranges merge with free neighbours
+    class RangeAllocator
+    {
+    public:
+        RangeAllocator();
+
+        // Returns false if no free range is large enough
+        bool allocate(GLuint count, GLuint* offset);
+
+        void release(GLuint offset, GLuint count);
+
+        // Adds [capacity, newCapacity) to the free ranges
+        void grow(GLuint newCapacity);
+
+        GLuint getCapacity();
+
+    private:
+        // offset -> number of free elements
+        std::map<GLuint, GLuint> freeRanges;
+        GLuint capacity;
+    };
+
+    // One vertex buffer and one index buffer shared by every gps::Mesh, with a single VAO
+    // for the gps::Vertex format. Meshes only keep their ranges, so a whole model can be
+    // drawn with glMultiDrawElementsBaseVertex and without switching buffers
+    class GeometryArena
+    {
+    public:
+        static GeometryArena& getInstance();
+
+        // Copies the data into the shared buffers, growing them if needed; the indices stay
+        // relative to the mesh's first vertex and are drawn with its baseVertex
+        GeometryRange allocate(const Vertex* vertices, GLsizei vertexCount, const GLuint* indices, GLsizei indexCount);
+
+        void release(GeometryRange range);
+
+        // Binds the VAO over the shared buffers
+        void bind();
+
+    private:
+        GLuint VAO;
+        GLuint VBO;
+        GLuint EBO;
+        RangeAllocator vertexAllocator;
+        RangeAllocator indexAllocator;
+
+        GeometryArena();
+
+        // Moves the contents to a larger buffer; returns the new buffer
+        GLuint growBuffer(GLuint buffer, GLsizeiptr oldSize, GLsizeiptr newSize);
+
+        // Points the VAO at the current buffers
+        void setupVertexArray();
+    };
+}
+
+#endif /* GeometryArena_hpp */
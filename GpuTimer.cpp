@@ -0,0 +1,74 @@
+#include "GpuTimer.hpp"
+
+namespace gps {
+
+	GpuTimer::GpuTimer() : oldest(0), pending(0), running(false), samples(0), totalNs(0) {
+	}
+
+	void GpuTimer::init() {
+		for (int i = 0; i < GPU_TIMER_QUERIES; i++) {
+			GLuint id;
+			glGenQueries(1, &id);
+			queries[i].reset(id);
+		}
+		oldest = 0;
+		pending = 0;
+		running = false;
+		clear();
+	}
+
+	void GpuTimer::reset() {
+		for (int i = 0; i < GPU_TIMER_QUERIES; i++) {
+			queries[i].reset();
+		}
+		pending = 0;
+		running = false;
+	}
+
+	void GpuTimer::begin() {
+		collect();
+		if (pending == GPU_TIMER_QUERIES || queries[0].get() == 0) {
+			return;
+		}
+		glBeginQuery(GL_TIME_ELAPSED, queries[(oldest + pending) % GPU_TIMER_QUERIES].get());
+		running = true;
+	}
+
+	void GpuTimer::end() {
+		if (running) {
+			glEndQuery(GL_TIME_ELAPSED);
+			pending++;
+			running = false;
+		}
+	}
+
+	void GpuTimer::collect() {
+		while (pending > 0) {
+			GLuint query = queries[oldest].get();
+			GLint available = 0;
+			glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available) {
+				break;
+			}
+			GLuint64 elapsedNs = 0;
+			glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsedNs);
+			totalNs += elapsedNs;
+			samples++;
+			oldest = (oldest + 1) % GPU_TIMER_QUERIES;
+			pending--;
+		}
+	}
+
+	size_t GpuTimer::getSampleCount() const {
+		return samples;
+	}
+
+	double GpuTimer::getAverageMs() const {
+		return samples > 0 ? (double)totalNs / samples / 1e6 : 0.0;
+	}
+
+	void GpuTimer::clear() {
+		samples = 0;
+		totalNs = 0;
+	}
+}
@@ -0,0 +1,49 @@
+#ifndef GpuTimer_hpp
+#define GpuTimer_hpp
+
+#include <GL/glew.h>
+
+#include "GLHandle.hpp"
+
+#include <cstddef>
+
+namespace gps {
+
+    // Queries in flight per timer; results arrive a few frames after the commands are issued
+    const int GPU_TIMER_QUERIES = 4;
+
+    // Measures how long the GPU spends on the commands between begin() and end(), without
+    // waiting for them: results are read once available and summed until clear(). Only one
+    // timer can be running at a time (GL_TIME_ELAPSED queries cannot nest)
+    class GpuTimer
+    {
+    public:
+        GpuTimer();
+
+        void init();
+        // Deletes the queries; call while the context still exists
+        void reset();
+
+        // A frame is skipped if all the queries are still waiting for their results
+        void begin();
+        void end();
+
+        // Adds the results that have arrived to the totals
+        void collect();
+        size_t getSampleCount() const;
+        double getAverageMs() const;
+        void clear();
+
+    private:
+        gps::QueryHandle queries[GPU_TIMER_QUERIES];
+        // Ring of queries in flight: the oldest one and how many follow it
+        int oldest;
+        int pending;
+        bool running;
+
+        size_t samples;
+        GLuint64 totalNs;
+    };
+}
+
+#endif /* GpuTimer_hpp */
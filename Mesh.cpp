@@ -1,71 +1,123 @@
 #include "Mesh.hpp"
+#include "GeometryArena.hpp"
+#include "GLState.hpp"
+
+#include <algorithm>
+#include <cmath>
+
 namespace gps {
 
 	/* Mesh Constructor */
 	Mesh::Mesh(std::vector<Vertex> vertices, std::vector<GLuint> indices, std::vector<Texture> textures)
+		: vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures))
 	{
-		this->vertices = vertices;
-		this->indices = indices;
-		this->textures = textures;
+		this->setupMesh(this->vertices.data(), (GLsizei)this->vertices.size(), this->indices.data(), (GLsizei)this->indices.size());
+	}
 
-		this->setupMesh();
+	Mesh::Mesh(const Vertex* vertices, GLsizei vertexCount, const GLuint* indices, GLsizei indexCount, std::vector<Texture> textures)
+		: textures(std::move(textures))
+	{
+		this->setupMesh(vertices, vertexCount, indices, indexCount);
 	}
 
-	Buffers Mesh::getBuffers() {
-	    return this->buffers;
+	// The moved-from mesh is left with an empty range, so only one of them releases it
+	Mesh::Mesh(Mesh&& other) noexcept
+		: vertices(std::move(other.vertices)), indices(std::move(other.indices)), textures(std::move(other.textures)), range(other.range), bounds(other.bounds), sphere(other.sphere)
+	{
+		other.range = GeometryRange();
 	}
 
-	/* Mesh drawing function - also applies associated textures */
-	void Mesh::Draw(gps::Shader shader)
+	Mesh& Mesh::operator=(Mesh&& other) noexcept
 	{
-		shader.useShaderProgram();
+		if (this != &other) {
+			GeometryArena::getInstance().release(this->range);
+			this->vertices = std::move(other.vertices);
+			this->indices = std::move(other.indices);
+			this->textures = std::move(other.textures);
+			this->range = other.range;
+			this->bounds = other.bounds;
+			this->sphere = other.sphere;
+			other.range = GeometryRange();
+		}
+		return *this;
+	}
 
-		//set textures
+	Mesh::~Mesh()
+	{
+		GeometryArena::getInstance().release(this->range);
+	}
+
+	GeometryRange Mesh::getRange() const {
+	    return this->range;
+	}
+
+	BoundingBox Mesh::getBounds() const {
+	    return this->bounds;
+	}
+
+	BoundingSphere Mesh::getBoundingSphere() const {
+	    return this->sphere;
+	}
+
+	bool Mesh::hasSameTextures(const Mesh& other) const {
+		if (this->textures.size() != other.textures.size()) {
+			return false;
+		}
+
+		for (GLuint i = 0; i < this->textures.size(); i++) {
+			if (this->textures[i].id != other.textures[i].id || this->textures[i].type != other.textures[i].type) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void Mesh::bindTextures(gps::Shader& shader) const
+	{
+		GLState& state = GLState::getInstance();
 		for (GLuint i = 0; i < textures.size(); i++)
 		{
-			glActiveTexture(GL_TEXTURE0 + i);
-			glUniform1i(glGetUniformLocation(shader.shaderProgram, this->textures[i].type.c_str()), i);
-			glBindTexture(GL_TEXTURE_2D, this->textures[i].id);
+			shader.setInt(this->textures[i].type.c_str(), i);
+			state.bindTexture(i, GL_TEXTURE_2D, this->textures[i].id);
+		}
+
+		// Units this mesh does not use are left empty, as if the previous mesh had unbound its textures
+		for (GLuint i = (GLuint)textures.size(); i < MESH_TEXTURE_UNITS; i++)
+		{
+			state.bindTexture(i, GL_TEXTURE_2D, 0);
 		}
+	}
 
-		glBindVertexArray(this->buffers.VAO);
-		glDrawElements(GL_TRIANGLES, this->indices.size(), GL_UNSIGNED_INT, 0);
-		glBindVertexArray(0);
+	/* Mesh drawing function - also applies associated textures */
+	void Mesh::Draw(gps::Shader& shader) const
+	{
+		shader.useShaderProgram();
 
-        for(GLuint i = 0; i < this->textures.size(); i++)
-        {
-            glActiveTexture(GL_TEXTURE0 + i);
-            glBindTexture(GL_TEXTURE_2D, 0);
-        }
+		//set textures
+		this->bindTextures(shader);
 
+		GeometryArena::getInstance().bind();
+		glDrawElementsBaseVertex(GL_TRIANGLES, this->range.indexCount, GL_UNSIGNED_INT,
+			(GLvoid*)(this->range.firstIndex * sizeof(GLuint)), this->range.baseVertex);
     }
 
-	// Initializes all the buffer objects/arrays
-	void Mesh::setupMesh(){
-		// Create buffers/arrays
-		glGenVertexArrays(1, &this->buffers.VAO);
-		glGenBuffers(1, &this->buffers.VBO);
-		glGenBuffers(1, &this->buffers.EBO);
-
-		glBindVertexArray(this->buffers.VAO);
-		// Load data into vertex buffers
-		glBindBuffer(GL_ARRAY_BUFFER, this->buffers.VBO);
-		glBufferData(GL_ARRAY_BUFFER, this->vertices.size() * sizeof(Vertex), &this->vertices[0], GL_STATIC_DRAW);
-
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->buffers.EBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, this->indices.size() * sizeof(GLuint), &this->indices[0], GL_STATIC_DRAW);
-
-		// Set the vertex attribute pointers
-		// Vertex Positions
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)0);
-		// Vertex Normals
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, Normal));
-		// Vertex Texture Coords
-		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, TexCoords));
-
-		glBindVertexArray(0);
+	// Copies the vertices and indices into the shared GeometryArena
+	void Mesh::setupMesh(const Vertex* vertexData, GLsizei vertexCount, const GLuint* indexData, GLsizei indexCount){
+		this->range = GeometryArena::getInstance().allocate(vertexData, vertexCount, indexData, indexCount);
+
+		this->bounds.min = vertexCount > 0 ? vertexData[0].Position : glm::vec3(0.0f);
+		this->bounds.max = this->bounds.min;
+		for (GLsizei i = 1; i < vertexCount; i++) {
+			this->bounds.min = glm::min(this->bounds.min, vertexData[i].Position);
+			this->bounds.max = glm::max(this->bounds.max, vertexData[i].Position);
+		}
+
+		this->sphere.center = (this->bounds.min + this->bounds.max) * 0.5f;
+		float radiusSquared = 0.0f;
+		for (GLsizei i = 0; i < vertexCount; i++) {
+			glm::vec3 offset = vertexData[i].Position - this->sphere.center;
+			radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+		}
+		this->sphere.radius = std::sqrt(radiusSquared);
 	}
 }
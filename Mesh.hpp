@@ -7,6 +7,7 @@
 #include "Shader.hpp"
 
 #include <string>
+#include <utility>
 #include <vector>
 
 
@@ -34,12 +35,30 @@ struct Material
         glm::vec3 specular;
     };
 
-struct Buffers {
-    GLuint VAO;
-    GLuint VBO;
-    GLuint EBO;
+// Texture units a mesh binds at most (ambient, diffuse and specular maps)
+const GLuint MESH_TEXTURE_UNITS = 3;
+
+// Axis-aligned box in model space
+struct BoundingBox {
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+// Sphere around the box center that contains every vertex, in model space
+struct BoundingSphere {
+    glm::vec3 center;
+    float radius;
 };
 
+// Where the mesh lives in the shared GeometryArena buffers
+struct GeometryRange {
+    GLint baseVertex;
+    GLsizei vertexCount;
+    GLuint firstIndex;
+    GLsizei indexCount;
+};
+
+// Owns its range of the GeometryArena and releases it when destroyed, so it is move-only
 class Mesh
 {
 public:
@@ -47,18 +66,42 @@ public:
     std::vector<GLuint> indices;
     std::vector<Texture> textures;
 
+	// The vectors are moved in; pass them with std::move to avoid copying them
 	Mesh(std::vector<Vertex> vertices, std::vector<GLuint> indices, std::vector<Texture> textures);
 
-	Buffers getBuffers();
+	// Uploads the vertex/index arrays as they are (e.g. straight from a mapped cache file);
+	// no CPU copy is kept, so vertices and indices stay empty
+	Mesh(const Vertex* vertices, GLsizei vertexCount, const GLuint* indices, GLsizei indexCount, std::vector<Texture> textures);
+
+	Mesh(const Mesh&) = delete;
+	Mesh& operator=(const Mesh&) = delete;
+	Mesh(Mesh&& other) noexcept;
+	Mesh& operator=(Mesh&& other) noexcept;
+	~Mesh();
+
+	GeometryRange getRange() const;
+
+	BoundingBox getBounds() const;
+
+	BoundingSphere getBoundingSphere() const;
+
+	// True if both meshes bind the same textures, so they can be drawn in one call
+	bool hasSameTextures(const Mesh& other) const;
+
+	// Binds the textures to units 0, 1, ... and sets the samplers named after their types;
+	// redundant binds are dropped by GLState
+	void bindTextures(gps::Shader& shader) const;
 
-	void Draw(gps::Shader shader);
+	void Draw(gps::Shader& shader) const;
 
 private:
     /*  Render data  */
-    Buffers buffers;
+    GeometryRange range;
+    BoundingBox bounds;
+    BoundingSphere sphere;
 
-	// Initializes all the buffer objects/arrays
-	void setupMesh();
+	// Copies the vertices and indices into the shared GeometryArena
+	void setupMesh(const Vertex* vertexData, GLsizei vertexCount, const GLuint* indexData, GLsizei indexCount);
 
 };
 
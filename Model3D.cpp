@@ -2,26 +2,447 @@
 
 namespace gps {
 
-	void Model3D::LoadModel(std::string fileName)
+	// Welding only merges bit-identical vertices, so hash and compare the raw bytes
+	struct VertexHash {
+		size_t operator()(const gps::Vertex& vertex) const {
+			uint32_t words[sizeof(gps::Vertex) / sizeof(uint32_t)];
+			memcpy(words, &vertex, sizeof(words));
+
+			// FNV-1a over the 32-bit words
+			size_t hash = 2166136261u;
+			for (size_t i = 0; i < sizeof(words) / sizeof(uint32_t); i++) {
+				hash ^= words[i];
+				hash *= 16777619u;
+			}
+			return hash;
+		}
+	};
+
+	struct VertexEqual {
+		bool operator()(const gps::Vertex& a, const gps::Vertex& b) const {
+			return memcmp(&a, &b, sizeof(gps::Vertex)) == 0;
+		}
+	};
+
+	// All model textures repeat and are trilinearly filtered
+	const gps::SamplerSettings MODEL_TEXTURE_SAMPLER = { GL_TEXTURE_2D, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR };
+
+	// Binary mesh cache stored next to each .obj as "<name>.obj.meshcache".
+	// Layout: MeshCacheHeader, then for every mesh a MeshCacheEntry, its texture
+	// references (type and path, each a uint32 length + characters padded to 4 bytes),
+	// its vertices and its indices.
+	// Bump MESH_CACHE_VERSION whenever this layout, gps::Vertex or the welding in ReadOBJ changes.
+	const uint32_t MESH_CACHE_MAGIC = 0x4D535047; // "GPSM"
+	const uint32_t MESH_CACHE_VERSION = 1;
+
+	struct MeshCacheHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint64_t sourceHash;
+		uint32_t meshCount;
+		uint32_t vertexSize;
+	};
+
+	struct MeshCacheEntry {
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		uint32_t textureCount;
+		uint32_t reserved;
+	};
+
+	// 64-bit FNV-1a, fed 8 bytes at a time
+	static uint64_t hashBytes(const char* data, size_t size, uint64_t hash) {
+		size_t i = 0;
+		for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+			uint64_t word;
+			memcpy(&word, data + i, sizeof(word));
+			hash ^= word;
+			hash *= 1099511628211ull;
+		}
+		for (; i < size; i++) {
+			hash ^= (unsigned char)data[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	// Hashes the contents of the .obj and of every .mtl it references, so editing any of them invalidates the cache
+	static bool hashModelSources(const std::string& fileName, const std::string& basePath, uint64_t* sourceHash) {
+		tinyobj::MappedFile obj;
+		if (!obj.open(fileName.c_str())) {
+			return false;
+		}
+
+		uint64_t hash = hashBytes(obj.data(), obj.size(), 14695981039346656037ull);
+
+		const char* line = obj.data();
+		const char* end = line + obj.size();
+		while (line < end) {
+			const char* newline = (const char*)memchr(line, '\n', end - line);
+			const char* lineEnd = newline ? newline : end;
+
+			if (lineEnd - line > 7 && strncmp(line, "mtllib", 6) == 0 && (line[6] == ' ' || line[6] == '\t')) {
+				const char* name = line + 7;
+				const char* nameEnd = name;
+				while (nameEnd < lineEnd && *nameEnd != ' ' && *nameEnd != '\t' && *nameEnd != '\r') {
+					nameEnd++;
+				}
+
+				tinyobj::MappedFile mtl;
+				if (mtl.open((basePath + std::string(name, nameEnd)).c_str())) {
+					hash = hashBytes(mtl.data(), mtl.size(), hash);
+				}
+			}
+
+			line = newline ? newline + 1 : end;
+		}
+
+		*sourceHash = hash;
+		return true;
+	}
+
+	// Copies `size` bytes at `*pos` into `out`, failing instead of reading past `end`
+	static bool readCache(const char** pos, const char* end, void* out, size_t size) {
+		if ((size_t)(end - *pos) < size) {
+			return false;
+		}
+		memcpy(out, *pos, size);
+		*pos += size;
+		return true;
+	}
+
+	static bool readCacheString(const char** pos, const char* end, std::string* out) {
+		uint32_t length;
+		if (!readCache(pos, end, &length, sizeof(length))) {
+			return false;
+		}
+		size_t paddedLength = (length + 3) & ~(size_t)3;
+		if ((size_t)(end - *pos) < paddedLength) {
+			return false;
+		}
+		out->assign(*pos, length);
+		*pos += paddedLength;
+		return true;
+	}
+
+	static void writeCacheString(std::ofstream& cache, const std::string& value) {
+		uint32_t length = (uint32_t)value.size();
+		const char padding[4] = { 0, 0, 0, 0 };
+		cache.write((const char*)&length, sizeof(length));
+		cache.write(value.data(), length);
+		cache.write(padding, ((length + 3) & ~3u) - length);
+	}
+
+	Model3D::Model3D() {
+		resident = false;
+		uploadedMeshCount = 0;
+		textureUploadTime = 0.0;
+		textureBytes = 0;
+		uncompressedTextureBytes = 0;
+	}
+
+	void Model3D::LoadModel(const std::string& fileName, PARSE_MODE parseMode)
+	{
+		ReadModel(fileName, parseMode);
+		while (UploadNext()) {
+		}
+	}
+
+    void Model3D::LoadModel(const std::string& fileName, const std::string& basePath, PARSE_MODE parseMode)
+	{
+		ReadModel(fileName, basePath, parseMode);
+		while (UploadNext()) {
+		}
+	}
+
+	void Model3D::ReadModel(const std::string& fileName, PARSE_MODE parseMode, unsigned int numThreads)
 	{
         std::string basePath = fileName.substr(0, fileName.find_last_of('/')) + "/";
-		ReadOBJ(fileName, basePath);
+		ReadModel(fileName, basePath, parseMode, numThreads);
+	}
+
+	void Model3D::ReadModel(const std::string& fileName, const std::string& basePath, PARSE_MODE parseMode, unsigned int numThreads)
+	{
+		std::string cacheFileName = fileName + ".meshcache";
+		uint64_t sourceHash;
+		bool hashed = hashModelSources(fileName, basePath, &sourceHash);
+
+		modelFileName = fileName;
+		bool cached = false;
+
+		if (hashed) {
+			auto cacheStart = std::chrono::high_resolution_clock::now();
+			if (ReadMeshCache(cacheFileName, sourceHash)) {
+				std::chrono::duration<double, std::milli> cacheTime = std::chrono::high_resolution_clock::now() - cacheStart;
+				std::cout << "Loading : " << fileName << " from cache (" << pendingMeshes.size() << " meshes, " << cacheTime.count() << " ms)" << std::endl;
+				cached = true;
+			}
+		}
+
+		if (!cached) {
+			ReadOBJ(fileName, basePath, parseMode, numThreads);
+
+			if (hashed) {
+				WriteMeshCache(cacheFileName, sourceHash);
+			}
+		}
+
+		DecodeTextures(numThreads);
+	}
+
+	// Decodes every texture the meshes reference at the same time
+	void Model3D::DecodeTextures(unsigned int numThreads)
+	{
+		if (pendingTextures.empty()) {
+			return;
+		}
+
+		std::vector<double> decodeTimes(pendingTextures.size());
+		auto decodeStart = std::chrono::high_resolution_clock::now();
+
+		gps::parallelFor(pendingTextures.size(), [&](size_t i) {
+			auto start = std::chrono::high_resolution_clock::now();
+			DecodeTexture(pendingTextures[i]);
+			std::chrono::duration<double, std::milli> time = std::chrono::high_resolution_clock::now() - start;
+			decodeTimes[i] = time.count();
+		}, numThreads);
+
+		std::chrono::duration<double, std::milli> decodeTime = std::chrono::high_resolution_clock::now() - decodeStart;
+		double serialTime = 0.0;
+		for (size_t i = 0; i < decodeTimes.size(); i++) {
+			serialTime += decodeTimes[i];
+		}
+
+		std::cout << "Texture decode : " << modelFileName << ": " << pendingTextures.size() << " images in " << decodeTime.count()
+			<< " ms (" << serialTime << " ms one after another)" << std::endl;
+	}
+
+	bool Model3D::ReadMeshCache(const std::string& cacheFileName, uint64_t sourceHash)
+	{
+		if (!meshCache.open(cacheFileName.c_str())) {
+			return false;
+		}
+
+		const char* pos = meshCache.data();
+		const char* end = pos + meshCache.size();
+
+		MeshCacheHeader header;
+		if (!readCache(&pos, end, &header, sizeof(header)) ||
+			header.magic != MESH_CACHE_MAGIC ||
+			header.version != MESH_CACHE_VERSION ||
+			header.sourceHash != sourceHash ||
+			header.vertexSize != sizeof(gps::Vertex)) {
+			meshCache.close();
+			return false;
+		}
+
+		// Validate the whole file before decoding any texture; the meshes are later
+		// uploaded straight from the mapped file
+		std::vector<gps::PendingMesh> cachedMeshes(header.meshCount);
+		std::vector<std::string> texturePaths;
+		std::vector<std::string> textureTypes;
+
+		for (size_t i = 0; i < cachedMeshes.size(); i++) {
+			gps::PendingMesh& mesh = cachedMeshes[i];
+			MeshCacheEntry entry;
+			if (!readCache(&pos, end, &entry, sizeof(entry))) {
+				meshCache.close();
+				return false;
+			}
+
+			for (size_t t = 0; t < entry.textureCount; t++) {
+				gps::Texture texture;
+				texture.id = 0;
+				if (!readCacheString(&pos, end, &texture.type) || !readCacheString(&pos, end, &texture.path)) {
+					meshCache.close();
+					return false;
+				}
+				mesh.textures.push_back(texture);
+			}
+
+			size_t vertexBytes = (size_t)entry.vertexCount * sizeof(gps::Vertex);
+			size_t indexBytes = (size_t)entry.indexCount * sizeof(GLuint);
+			if ((size_t)(end - pos) < vertexBytes + indexBytes) {
+				meshCache.close();
+				return false;
+			}
+			mesh.vertexData = (const gps::Vertex*)pos;
+			mesh.vertexCount = (GLsizei)entry.vertexCount;
+			mesh.indexData = (const GLuint*)(pos + vertexBytes);
+			mesh.indexCount = (GLsizei)entry.indexCount;
+			pos += vertexBytes + indexBytes;
+		}
+
+		for (size_t i = 0; i < cachedMeshes.size(); i++) {
+			for (size_t t = 0; t < cachedMeshes[i].textures.size(); t++) {
+				cachedMeshes[i].textures[t] = LoadTexture(cachedMeshes[i].textures[t].path, cachedMeshes[i].textures[t].type);
+			}
+		}
+
+		pendingMeshes.swap(cachedMeshes);
+		return true;
+	}
+
+	void Model3D::WriteMeshCache(const std::string& cacheFileName, uint64_t sourceHash)
+	{
+		// Written under a temporary name first, so an interrupted write never leaves a valid-looking cache.
+		// The name is unique per write: two loader threads may load the same model at once
+		static std::atomic<uint32_t> writeCount(0);
+		std::string tempFileName = cacheFileName + "." + std::to_string(writeCount++) + ".tmp";
+		std::ofstream cache(tempFileName.c_str(), std::ios::binary);
+
+		MeshCacheHeader header;
+		header.magic = MESH_CACHE_MAGIC;
+		header.version = MESH_CACHE_VERSION;
+		header.sourceHash = sourceHash;
+		header.meshCount = (uint32_t)pendingMeshes.size();
+		header.vertexSize = sizeof(gps::Vertex);
+		cache.write((const char*)&header, sizeof(header));
+
+		for (size_t i = 0; i < pendingMeshes.size(); i++) {
+			const gps::PendingMesh& mesh = pendingMeshes[i];
+
+			MeshCacheEntry entry;
+			entry.vertexCount = (uint32_t)mesh.vertexCount;
+			entry.indexCount = (uint32_t)mesh.indexCount;
+			entry.textureCount = (uint32_t)mesh.textures.size();
+			entry.reserved = 0;
+			cache.write((const char*)&entry, sizeof(entry));
+
+			for (size_t t = 0; t < mesh.textures.size(); t++) {
+				writeCacheString(cache, mesh.textures[t].type);
+				writeCacheString(cache, mesh.textures[t].path);
+			}
+
+			cache.write((const char*)mesh.vertexData, mesh.vertexCount * sizeof(gps::Vertex));
+			cache.write((const char*)mesh.indexData, mesh.indexCount * sizeof(GLuint));
+		}
+
+		cache.close();
+		if (!cache) {
+			fprintf(stderr, "WARNING: could not write mesh cache %s\n", cacheFileName.c_str());
+			remove(tempFileName.c_str());
+			return;
+		}
+
+		remove(cacheFileName.c_str());
+		rename(tempFileName.c_str(), cacheFileName.c_str());
+	}
+
+	// Draw each mesh from the model - one multi-draw call per set of textures
+	void Model3D::Draw(gps::Shader& shaderProgram)
+	{
+		if (!resident) {
+			return;
+		}
+
+		for (size_t b = 0; b < drawBatches.size(); b++) {
+			Draw(shaderProgram, b);
+		}
+	}
+
+	void Model3D::Draw(gps::Shader& shaderProgram, size_t batchIndex)
+	{
+		const gps::DrawBatch& batch = drawBatches[batchIndex];
+
+		shaderProgram.useShaderProgram();
+		GeometryArena::getInstance().bind();
+
+		meshes[batch.firstMesh].bindTextures(shaderProgram);
+		glMultiDrawElementsBaseVertex(GL_TRIANGLES, batch.counts.data(), GL_UNSIGNED_INT, batch.offsets.data(),
+			(GLsizei)batch.counts.size(), batch.baseVertices.data());
 	}
 
-    void Model3D::LoadModel(std::string fileName, std::string basePath)
+	size_t Model3D::getBatchCount()
 	{
-		ReadOBJ(fileName, basePath);
+		return resident ? drawBatches.size() : 0;
 	}
 
-	// Draw each mesh from the model
-	void Model3D::Draw(gps::Shader shaderProgram)
+	const gps::DrawBatch& Model3D::getBatch(size_t batchIndex)
 	{
-		for (int i = 0; i < meshes.size(); i++)
-			meshes[i].Draw(shaderProgram);
+		return drawBatches[batchIndex];
+	}
+
+	gps::BoundingBox Model3D::getBounds()
+	{
+		return bounds;
+	}
+
+	gps::BoundingSphere Model3D::getBoundingSphere()
+	{
+		return sphere;
+	}
+
+	// Small ids for the distinct texture sets of all models; only used on the OpenGL thread
+	static uint32_t getMaterialId(const std::vector<gps::Texture>& textures)
+	{
+		static std::map<std::vector<GLuint>, uint32_t> materialIds;
+
+		std::vector<GLuint> textureIds(textures.size());
+		for (size_t i = 0; i < textures.size(); i++) {
+			textureIds[i] = textures[i].id;
+		}
+
+		auto material = materialIds.find(textureIds);
+		if (material != materialIds.end()) {
+			return material->second;
+		}
+
+		uint32_t materialId = (uint32_t)materialIds.size();
+		materialIds[textureIds] = materialId;
+		return materialId;
+	}
+
+	// Groups the meshes by their textures and computes the model bounds
+	void Model3D::BuildDrawBatches()
+	{
+		drawBatches.clear();
+		bounds.min = glm::vec3(0.0f);
+		bounds.max = glm::vec3(0.0f);
+		bool emptyBounds = true;
+
+		for (size_t i = 0; i < meshes.size(); i++) {
+			size_t b = 0;
+			while (b < drawBatches.size() && !meshes[i].hasSameTextures(meshes[drawBatches[b].firstMesh])) {
+				b++;
+			}
+			if (b == drawBatches.size()) {
+				drawBatches.push_back(gps::DrawBatch());
+				drawBatches[b].firstMesh = i;
+				drawBatches[b].materialId = getMaterialId(meshes[i].textures);
+				drawBatches[b].bounds = meshes[i].getBounds();
+			}
+
+			gps::GeometryRange range = meshes[i].getRange();
+			if (range.indexCount == 0) {
+				continue;
+			}
+			gps::BoundingBox meshBounds = meshes[i].getBounds();
+			drawBatches[b].bounds.min = glm::min(drawBatches[b].bounds.min, meshBounds.min);
+			drawBatches[b].bounds.max = glm::max(drawBatches[b].bounds.max, meshBounds.max);
+			drawBatches[b].counts.push_back(range.indexCount);
+			drawBatches[b].offsets.push_back((const GLvoid*)(range.firstIndex * sizeof(GLuint)));
+			drawBatches[b].baseVertices.push_back(range.baseVertex);
+
+			bounds.min = emptyBounds ? meshBounds.min : glm::min(bounds.min, meshBounds.min);
+			bounds.max = emptyBounds ? meshBounds.max : glm::max(bounds.max, meshBounds.max);
+			emptyBounds = false;
+		}
+
+		// The sphere around the box center that contains every mesh sphere
+		sphere.center = (bounds.min + bounds.max) * 0.5f;
+		sphere.radius = 0.0f;
+		for (size_t i = 0; i < meshes.size(); i++) {
+			if (meshes[i].getRange().indexCount == 0) {
+				continue;
+			}
+			gps::BoundingSphere meshSphere = meshes[i].getBoundingSphere();
+			sphere.radius = std::max(sphere.radius, glm::length(meshSphere.center - sphere.center) + meshSphere.radius);
+		}
 	}
 
 	// Does the parsing of the .obj file and fills in the data structure
-	void Model3D::ReadOBJ(std::string fileName, std::string basePath){
+	void Model3D::ReadOBJ(const std::string& fileName, const std::string& basePath, PARSE_MODE parseMode, unsigned int numThreads){
 
         std::cout << "Loading : " << fileName << std::endl;
 		tinyobj::attrib_t attrib;
@@ -30,7 +451,15 @@ namespace gps {
 		int materialId;
 
 		std::string err;
-		bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &err, fileName.c_str(), basePath.c_str(), GL_TRUE);
+		auto parseStart = std::chrono::high_resolution_clock::now();
+		bool ret;
+		if (parseMode == PARSE_PARALLEL) {
+			ret = tinyobj::LoadObjParallel(&attrib, &shapes, &materials, &err, fileName.c_str(), basePath.c_str(), GL_TRUE, numThreads);
+		}
+		else {
+			ret = tinyobj::LoadObjMapped(&attrib, &shapes, &materials, &err, fileName.c_str(), basePath.c_str(), GL_TRUE);
+		}
+		std::chrono::duration<double, std::milli> parseTime = std::chrono::high_resolution_clock::now() - parseStart;
 
 		if (!err.empty()) { // `err` may contain warning message.
 			std::cerr << err << std::endl;
@@ -42,6 +471,10 @@ namespace gps {
 
 		std::cout << "# of shapes    : " << shapes.size() << std::endl;
 		std::cout << "# of materials : " << materials.size() << std::endl;
+		std::cout << "Parse time     : " << parseTime.count() << " ms" << std::endl;
+
+		size_t faceVertexCount = 0;
+		size_t uniqueVertexCount = 0;
 
 		// Loop over shapes
 		for (size_t s = 0; s < shapes.size(); s++) {
@@ -49,6 +482,11 @@ namespace gps {
 			std::vector<GLuint> indices;
 			std::vector<gps::Texture> textures;
 
+			// Face corners sharing position, normal and texture coordinates are welded into one vertex
+			std::unordered_map<gps::Vertex, GLuint, VertexHash, VertexEqual> uniqueVertices;
+			uniqueVertices.reserve(shapes[s].mesh.indices.size());
+			indices.reserve(shapes[s].mesh.indices.size());
+
 			// Loop over faces(polygon)
 			size_t index_offset = 0;
 			for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++) {
@@ -84,14 +522,20 @@ namespace gps {
 					currentVertex.Normal = vertexNormal;
 					currentVertex.TexCoords = vertexTexCoords;
 
-					vertices.push_back(currentVertex);
+					auto inserted = uniqueVertices.insert(std::make_pair(currentVertex, (GLuint)vertices.size()));
+					if (inserted.second) {
+						vertices.push_back(currentVertex);
+					}
 
-					indices.push_back(index_offset + v);
+					indices.push_back(inserted.first->second);
 				}
 
 				index_offset += fv;
 			}
 
+			faceVertexCount += indices.size();
+			uniqueVertexCount += vertices.size();
+
 			// get material id
 			// Only try to read materials if the .mtl file is present
 			int a = shapes[s].mesh.material_ids.size();
@@ -132,39 +576,103 @@ namespace gps {
 				}
 			}
 
-			meshes.push_back(gps::Mesh(vertices, indices, textures));
+			pendingMeshes.push_back(gps::PendingMesh());
+			gps::PendingMesh& pendingMesh = pendingMeshes.back();
+			pendingMesh.vertices.swap(vertices);
+			pendingMesh.indices.swap(indices);
+			pendingMesh.vertexData = pendingMesh.vertices.data();
+			pendingMesh.vertexCount = (GLsizei)pendingMesh.vertices.size();
+			pendingMesh.indexData = pendingMesh.indices.data();
+			pendingMesh.indexCount = (GLsizei)pendingMesh.indices.size();
+			pendingMesh.textures.swap(textures);
+		}
+
+		std::cout << "# of vertices  : " << uniqueVertexCount << " unique of " << faceVertexCount << " face vertices" << std::endl;
+		std::cout << "VBO size       : " << uniqueVertexCount * sizeof(gps::Vertex) / 1024 << " KB (unwelded "
+			<< faceVertexCount * sizeof(gps::Vertex) / 1024 << " KB)" << std::endl;
+	}
+
+	void Model3D::DecodeTexture(gps::PendingTexture& pendingTexture)
+	{
+		// Already uploaded for another model - share it
+		pendingTexture.id = TextureCache::getInstance().acquire(pendingTexture.path, MODEL_TEXTURE_SAMPLER);
+		if (pendingTexture.id != 0) {
+			return;
+		}
+
+		std::string ddsFileName = pendingTexture.path + ".dds";
+		uint64_t sourceHash = 0;
+		bool hashed = false;
+
+		tinyobj::MappedFile source;
+		if (source.open(pendingTexture.path.c_str())) {
+			sourceHash = hashBytes(source.data(), source.size(), 14695981039346656037ull);
+			hashed = true;
+			source.close();
+
+			if (readDDS(ddsFileName, sourceHash, &pendingTexture.compressed)) {
+				return;
+			}
+		}
+
+		pendingTexture.pixels = ReadTextureFromFile(pendingTexture.path.c_str(), &pendingTexture.width, &pendingTexture.height);
+
+		if (pendingTexture.pixels && hashed) {
+			compressTexture(pendingTexture.pixels, pendingTexture.width, pendingTexture.height, &pendingTexture.compressed);
+			stbi_image_free(pendingTexture.pixels);
+			pendingTexture.pixels = NULL;
+
+			if (!writeDDS(ddsFileName, sourceHash, pendingTexture.compressed)) {
+				fprintf(stderr, "WARNING: could not write compressed texture %s\n", ddsFileName.c_str());
+			}
 		}
 	}
 
 	// Retrieves a texture associated with the object - by its name and type
-	gps::Texture Model3D::LoadTexture(std::string path, std::string type) {
+	gps::Texture Model3D::LoadTexture(const std::string& path, const std::string& type) {
 
-			for (int i = 0; i < loadedTextures.size(); i++) {
-				if (loadedTextures[i].path == path)
+			gps::Texture currentTexture;
+			currentTexture.id = 0;
+
+			for (int i = 0; i < pendingTextures.size(); i++) {
+				if (pendingTextures[i].path == path)
 				{
 					//already loaded texture
-					return loadedTextures[i];
+					currentTexture.type = pendingTextures[i].type;
+					currentTexture.path = path;
+					return currentTexture;
 				}
 			}
 
-			gps::Texture currentTexture;
-			currentTexture.id = ReadTextureFromFile(path.c_str());
-			currentTexture.type = std::string(type);
-			currentTexture.path = path;
+			// Decoded later by DecodeTextures, together with the other textures
+			gps::PendingTexture pendingTexture;
+			pendingTexture.path = path;
+			pendingTexture.type = std::string(type);
+			pendingTexture.id = 0;
+			pendingTexture.compressed.levels = 0;
+			pendingTexture.width = 0;
+			pendingTexture.height = 0;
+			pendingTexture.pixels = NULL;
 
-			loadedTextures.push_back(currentTexture);
+			pendingTextures.push_back(pendingTexture);
 
+			currentTexture.type = pendingTexture.type;
+			currentTexture.path = path;
 			return currentTexture;
 		}
 
-	// Reads the pixel data from an image file and loads it into the video memory
-	GLuint Model3D::ReadTextureFromFile(const char* file_name) {
+	// Reads the pixel data from an image file
+	unsigned char* Model3D::ReadTextureFromFile(const char* file_name, int* width, int* height) {
 		int x, y, n;
 		int force_channels = 4;
+		// OpenGL expects the bottom row first; stb_image flips the rows with memcpy while decoding.
+		// The flag is per thread, so it is switched back off for the other stbi_load callers (e.g. the skybox)
+		stbi_set_flip_vertically_on_load_thread(1);
 		unsigned char* image_data = stbi_load(file_name, &x, &y, &n, force_channels);
+		stbi_set_flip_vertically_on_load_thread(0);
 		if (!image_data) {
 			fprintf(stderr, "ERROR: could not load %s\n", file_name);
-			return false;
+			return NULL;
 		}
 		// NPOT check
 		if ((x & (x - 1)) != 0 || (y & (y - 1)) != 0) {
@@ -173,27 +681,16 @@ namespace gps {
 			);
 		}
 
-		int width_in_bytes = x * 4;
-		unsigned char *top = NULL;
-		unsigned char *bottom = NULL;
-		unsigned char temp = 0;
-		int half_height = y / 2;
-
-		for (int row = 0; row < half_height; row++) {
-			top = image_data + row * width_in_bytes;
-			bottom = image_data + (y - row - 1) * width_in_bytes;
-			for (int col = 0; col < width_in_bytes; col++) {
-				temp = *top;
-				*top = *bottom;
-				*bottom = temp;
-				top++;
-				bottom++;
-			}
-		}
+		*width = x;
+		*height = y;
+		return image_data;
+	}
 
+	// Loads the pixel data into the video memory
+	GLuint Model3D::UploadTexture(const unsigned char* image_data, int x, int y) {
 		GLuint textureID;
 		glGenTextures(1, &textureID);
-		glBindTexture(GL_TEXTURE_2D, textureID);
+		GLState::getInstance().bindTexture(0, GL_TEXTURE_2D, textureID);
 		glTexImage2D(
 			GL_TEXTURE_2D,
 			0,
@@ -211,23 +708,139 @@ namespace gps {
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glBindTexture(GL_TEXTURE_2D, 0);
+		GLState::getInstance().bindTexture(0, GL_TEXTURE_2D, 0);
+
+		return textureID;
+	}
+
+	// Uploads one pending texture or mesh on the OpenGL thread; returns false once the model is resident
+	bool Model3D::UploadNext() {
+		if (resident) {
+			return false;
+		}
+
+		// Textures go first, so every mesh can resolve its texture ids
+		if (!pendingTextures.empty()) {
+			gps::PendingTexture& pendingTexture = pendingTextures.back();
+
+			gps::Texture currentTexture;
+			currentTexture.id = 0;
+			auto uploadStart = std::chrono::high_resolution_clock::now();
+			if (pendingTexture.id != 0) {
+				currentTexture.id = pendingTexture.id;
+			}
+			else if (pendingTexture.compressed.levels > 0) {
+				size_t bytes = pendingTexture.compressed.data.size();
+				currentTexture.id = TextureCache::getInstance().insert(pendingTexture.path, MODEL_TEXTURE_SAMPLER,
+					UploadCompressedTexture(pendingTexture.compressed), bytes);
+				textureBytes += bytes;
+				uncompressedTextureBytes += (size_t)pendingTexture.compressed.width * pendingTexture.compressed.height * 4 * 4 / 3;
+			}
+			else if (pendingTexture.pixels) {
+				size_t bytes = (size_t)pendingTexture.width * pendingTexture.height * 4 * 4 / 3;
+				currentTexture.id = TextureCache::getInstance().insert(pendingTexture.path, MODEL_TEXTURE_SAMPLER,
+					UploadTexture(pendingTexture.pixels, pendingTexture.width, pendingTexture.height), bytes);
+				textureBytes += bytes;
+				uncompressedTextureBytes += bytes;
+				stbi_image_free(pendingTexture.pixels);
+			}
+			std::chrono::duration<double, std::milli> uploadTime = std::chrono::high_resolution_clock::now() - uploadStart;
+			textureUploadTime += uploadTime.count();
+			currentTexture.type = pendingTexture.type;
+			currentTexture.path = pendingTexture.path;
+			loadedTextures.push_back(currentTexture);
+
+			pendingTextures.pop_back();
+			return true;
+		}
+
+		if (uploadedMeshCount < pendingMeshes.size()) {
+			gps::PendingMesh& pendingMesh = pendingMeshes[uploadedMeshCount++];
+
+			for (size_t t = 0; t < pendingMesh.textures.size(); t++) {
+				for (size_t i = 0; i < loadedTextures.size(); i++) {
+					if (loadedTextures[i].path == pendingMesh.textures[t].path) {
+						pendingMesh.textures[t].id = loadedTextures[i].id;
+						break;
+					}
+				}
+			}
+
+			if (meshes.empty()) {
+				meshes.reserve(pendingMeshes.size());
+			}
+			meshes.emplace_back(pendingMesh.vertexData, pendingMesh.vertexCount, pendingMesh.indexData, pendingMesh.indexCount, std::move(pendingMesh.textures));
+			return true;
+		}
+
+		if (!loadedTextures.empty()) {
+			std::cout << "Texture upload : " << modelFileName << ": " << loadedTextures.size() << " images in " << textureUploadTime << " ms, "
+				<< textureBytes / 1024 << " KB with mipmaps (" << uncompressedTextureBytes / 1024 << " KB as RGBA8)" << std::endl;
+		}
+
+		BuildDrawBatches();
+
+		// Everything is in the video memory - drop the CPU copies
+		std::vector<gps::PendingMesh>().swap(pendingMeshes);
+		uploadedMeshCount = 0;
+		meshCache.close();
+		resident = true;
+		return false;
+	}
+
+	bool Model3D::isResident() {
+		return resident;
+	}
+
+	// Loads the precompressed mip levels into the video memory
+	GLuint Model3D::UploadCompressedTexture(const gps::CompressedTexture& texture) {
+		GLuint textureID;
+		glGenTextures(1, &textureID);
+		GLState::getInstance().bindTexture(0, GL_TEXTURE_2D, textureID);
+
+		const unsigned char* levelData = texture.data.data();
+		int levelWidth = texture.width;
+		int levelHeight = texture.height;
+		for (int level = 0; level < texture.levels; level++) {
+			GLsizei levelSize = (GLsizei)compressedLevelSize(texture.format, levelWidth, levelHeight);
+			glCompressedTexImage2D(GL_TEXTURE_2D, level, texture.format, levelWidth, levelHeight, 0, levelSize, levelData);
+
+			levelData += levelSize;
+			levelWidth = std::max(1, levelWidth / 2);
+			levelHeight = std::max(1, levelHeight / 2);
+		}
+
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, texture.levels - 1);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		GLState::getInstance().bindTexture(0, GL_TEXTURE_2D, 0);
 
 		return textureID;
 	}
 
 	Model3D::~Model3D() {
-        for (size_t i = 0; i < loadedTextures.size(); i++) {
-            glDeleteTextures(1, &loadedTextures.at(i).id);
+		reset();
+	}
+
+	void Model3D::reset() {
+        for (size_t i = 0; i < pendingTextures.size(); i++) {
+            stbi_image_free(pendingTextures.at(i).pixels);
+            TextureCache::getInstance().release(pendingTextures.at(i).id);
         }
+        pendingTextures.clear();
+        pendingMeshes.clear();
 
-        for (size_t i = 0; i < meshes.size(); i++) {
-            GLuint VBO = meshes.at(i).getBuffers().VBO;
-            GLuint EBO = meshes.at(i).getBuffers().EBO;
-            GLuint VAO = meshes.at(i).getBuffers().VAO;
-            glDeleteBuffers(1, &VBO);
-            glDeleteBuffers(1, &EBO);
-            glDeleteVertexArrays(1, &VAO);
+        // Shared textures are only deleted once no model references them
+        for (size_t i = 0; i < loadedTextures.size(); i++) {
+            TextureCache::getInstance().release(loadedTextures.at(i).id);
         }
+        loadedTextures.clear();
+        // The meshes release their GeometryArena ranges themselves
+        meshes.clear();
+        drawBatches.clear();
+        uploadedMeshCount = 0;
+        resident = false;
 	}
 }
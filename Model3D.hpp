@@ -1,43 +1,168 @@
 #ifndef Model3D_hpp
 #define Model3D_hpp
 
+#include "GeometryArena.hpp"
+#include "GLState.hpp"
 #include "Mesh.hpp"
+#include "Parallel.hpp"
+#include "TextureCache.hpp"
+#include "TextureCompressor.hpp"
 
 #include "tiny_obj_loader.h"
 #include "stb_image.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <map>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace gps {
 
+    // How the .obj file is parsed: mapped into memory and parsed on the calling
+    // thread, or additionally split into chunks that are tokenized on all cores
+    enum PARSE_MODE {PARSE_MAPPED, PARSE_PARALLEL};
+
+    // Decoded image waiting to be uploaded to the video memory - block-compressed, or as
+    // RGBA8 pixels if it could not be compressed. Images another model already uploaded
+    // are not decoded again; they only carry the id referenced in the TextureCache
+    struct PendingTexture {
+        std::string path;
+        std::string type;
+        GLuint id;
+        gps::CompressedTexture compressed;
+        int width;
+        int height;
+        unsigned char* pixels;
+    };
+
+    // Mesh data waiting to be uploaded; vertexData/indexData point either into the
+    // vectors below or into the mapped mesh cache
+    struct PendingMesh {
+        std::vector<gps::Vertex> vertices;
+        std::vector<GLuint> indices;
+        const gps::Vertex* vertexData;
+        GLsizei vertexCount;
+        const GLuint* indexData;
+        GLsizei indexCount;
+        std::vector<gps::Texture> textures;
+    };
+
+    // Meshes that bind the same textures, submitted with one glMultiDrawElementsBaseVertex
+    struct DrawBatch {
+        size_t firstMesh;
+        // Same for every batch, in any model, that binds the same textures
+        uint32_t materialId;
+        gps::BoundingBox bounds;
+        std::vector<GLsizei> counts;
+        std::vector<const GLvoid*> offsets;
+        std::vector<GLint> baseVertices;
+    };
+
     class Model3D
     {
 
     public:
+        Model3D();
         ~Model3D();
 
-		void LoadModel(std::string fileName);
+		// Releases the textures and meshes, leaving the model empty and not resident; call while
+		// the context still exists and no loader thread is reading the model
+		void reset();
+
+		// Reads and uploads the model before returning
+		void LoadModel(const std::string& fileName, PARSE_MODE parseMode = PARSE_MAPPED);
+
+		void LoadModel(const std::string& fileName, const std::string& basePath, PARSE_MODE parseMode = PARSE_MAPPED);
+
+		// Reads the files and decodes the textures without touching OpenGL, so it can run on a loader thread.
+		// The parsing and decoding use up to numThreads threads, the calling one included (one per core if 0)
+		void ReadModel(const std::string& fileName, PARSE_MODE parseMode = PARSE_MAPPED, unsigned int numThreads = 0);
+
+		void ReadModel(const std::string& fileName, const std::string& basePath, PARSE_MODE parseMode = PARSE_MAPPED, unsigned int numThreads = 0);
+
+		// Uploads one pending texture or mesh on the OpenGL thread; returns false once the model is resident
+		bool UploadNext();
+
+		// A model is resident once all its meshes and textures are in the video memory
+		bool isResident();
 
-		void LoadModel(std::string fileName, std::string basePath);
+		// Does nothing until the model is resident
+		void Draw(gps::Shader& shaderProgram);
 
-		void Draw(gps::Shader shaderProgram);
+		// Draws one batch; only valid while the model is resident
+		void Draw(gps::Shader& shaderProgram, size_t batchIndex);
+
+		// Number of batches to draw, 0 until the model is resident
+		size_t getBatchCount();
+
+		const gps::DrawBatch& getBatch(size_t batchIndex);
+
+		// Bounds of all the meshes, in model space; only valid while the model is resident
+		gps::BoundingBox getBounds();
+		gps::BoundingSphere getBoundingSphere();
 
     private:
 		// Component meshes - group of objects
         std::vector<gps::Mesh> meshes;
+		// Built once the model is resident
+        std::vector<gps::DrawBatch> drawBatches;
+        gps::BoundingBox bounds;
+        gps::BoundingSphere sphere;
 		// Associated textures
         std::vector<gps::Texture> loadedTextures;
 
+		bool resident;
+		// Filled by ReadModel, emptied by UploadNext
+		std::vector<gps::PendingTexture> pendingTextures;
+		std::vector<gps::PendingMesh> pendingMeshes;
+		size_t uploadedMeshCount;
+		// Kept mapped until its meshes are uploaded
+		tinyobj::MappedFile meshCache;
+
+		std::string modelFileName;
+		double textureUploadTime;
+		size_t textureBytes;
+		size_t uncompressedTextureBytes;
+
+		// Groups the meshes by their textures and computes the model bounds
+		void BuildDrawBatches();
+
 		// Does the parsing of the .obj file and fills in the data structure
-		void ReadOBJ(std::string fileName, std::string basePath);
+		void ReadOBJ(const std::string& fileName, const std::string& basePath, PARSE_MODE parseMode, unsigned int numThreads);
+
+		// Reads the meshes from the binary cache next to the .obj; fails if the cache
+		// is missing, from another format version or built from different sources
+		bool ReadMeshCache(const std::string& cacheFileName, uint64_t sourceHash);
+
+		// Saves the vertices, indices and texture references of all pending meshes to the binary cache
+		void WriteMeshCache(const std::string& cacheFileName, uint64_t sourceHash);
+
+		// Retrieves a texture associated with the object - by its name and type; the image
+		// is decoded once and its id is only known after upload
+		gps::Texture LoadTexture(const std::string& path, const std::string& type);
+
+		// Decodes all pending textures in parallel
+		void DecodeTextures(unsigned int numThreads);
+
+		// Loads the block-compressed copy of an image ("<image>.dds"), encoding it on first use
+		void DecodeTexture(gps::PendingTexture& pendingTexture);
+
+		// Reads the pixel data from an image file; free it with stbi_image_free
+		unsigned char* ReadTextureFromFile(const char* file_name, int* width, int* height);
 
-		// Retrieves a texture associated with the object - by its name and type
-		gps::Texture LoadTexture(std::string path, std::string type);
+		// Loads the pixel data into the video memory
+		GLuint UploadTexture(const unsigned char* image_data, int width, int height);
 
-		// Reads the pixel data from an image file and loads it into the video memory
-		GLuint ReadTextureFromFile(const char* file_name);
+		// Loads the precompressed mip levels into the video memory
+		GLuint UploadCompressedTexture(const gps::CompressedTexture& texture);
     };
 }
 
@@ -0,0 +1,117 @@
+#include "ModelLoader.hpp"
+
+namespace gps {
+
+	ModelLoader::ModelLoader() {
+		unfinishedCount = 0;
+		stopping = false;
+		coreCount = std::max(std::thread::hardware_concurrency(), 1u);
+		busyWorkers = 0;
+		extraThreads = 0;
+	}
+
+	ModelLoader::~ModelLoader() {
+		stop();
+	}
+
+	void ModelLoader::stop() {
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			stopping = true;
+		}
+		requestQueued.notify_all();
+
+		for (size_t i = 0; i < workers.size(); i++) {
+			workers[i].join();
+		}
+		workers.clear();
+	}
+
+	void ModelLoader::start(unsigned int numThreads) {
+		if (numThreads == 0) {
+			numThreads = std::thread::hardware_concurrency();
+		}
+		if (numThreads == 0) {
+			numThreads = 1;
+		}
+
+		for (unsigned int i = 0; i < numThreads; i++) {
+			workers.push_back(std::thread(&ModelLoader::workerLoop, this));
+		}
+	}
+
+	void ModelLoader::loadModel(gps::Model3D* model, std::string fileName, PARSE_MODE parseMode) {
+		LoadRequest request;
+		request.model = model;
+		request.fileName = fileName;
+		request.parseMode = parseMode;
+
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			requests.push_back(request);
+			unfinishedCount++;
+		}
+		requestQueued.notify_one();
+	}
+
+	void ModelLoader::uploadReady(double budgetMs) {
+		auto uploadStart = std::chrono::high_resolution_clock::now();
+
+		while (true) {
+			gps::Model3D* model;
+			{
+				std::lock_guard<std::mutex> lock(queueMutex);
+				if (readyModels.empty()) {
+					return;
+				}
+				model = readyModels.front();
+			}
+
+			// Only this thread touches a ready model, so the upload itself runs unlocked
+			if (!model->UploadNext()) {
+				std::lock_guard<std::mutex> lock(queueMutex);
+				readyModels.pop_front();
+				unfinishedCount--;
+			}
+
+			std::chrono::duration<double, std::milli> uploadTime = std::chrono::high_resolution_clock::now() - uploadStart;
+			if (uploadTime.count() >= budgetMs) {
+				return;
+			}
+		}
+	}
+
+	bool ModelLoader::isIdle() {
+		std::lock_guard<std::mutex> lock(queueMutex);
+		return unfinishedCount == 0;
+	}
+
+	void ModelLoader::workerLoop() {
+		while (true) {
+			LoadRequest request;
+			unsigned int extra;
+			{
+				std::unique_lock<std::mutex> lock(queueMutex);
+				requestQueued.wait(lock, [this] { return stopping || !requests.empty(); });
+				if (stopping) {
+					return;
+				}
+				request = requests.front();
+				requests.pop_front();
+
+				busyWorkers++;
+				unsigned int used = busyWorkers + extraThreads;
+				extra = used < coreCount ? coreCount - used : 0;
+				extraThreads += extra;
+			}
+
+			// File I/O, parsing and image decoding - no OpenGL calls
+			request.model->ReadModel(request.fileName, request.parseMode, extra + 1);
+
+			std::lock_guard<std::mutex> lock(queueMutex);
+			busyWorkers--;
+			extraThreads -= extra;
+			readyModels.push_back(request.model);
+		}
+	}
+}
@@ -0,0 +1,65 @@
+#ifndef ModelLoader_hpp
+#define ModelLoader_hpp
+
+#include "Model3D.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace gps {
+
+    // Reads models and decodes their textures on a pool of worker threads; the
+    // OpenGL uploads run on the render thread, a few at a time each frame
+    class ModelLoader
+    {
+    public:
+        ModelLoader();
+        ~ModelLoader();
+
+        // Starts the worker threads - one per core if numThreads is 0
+        void start(unsigned int numThreads = 0);
+        // Stops the workers once they finish the model they are reading; the queued ones are dropped
+        void stop();
+
+        // Queues a model for loading; it is not drawn until it becomes resident
+        void loadModel(gps::Model3D* model, std::string fileName, PARSE_MODE parseMode = PARSE_MAPPED);
+
+        // Uploads read models until budgetMs is spent (at least one upload per call, so loading always progresses)
+        void uploadReady(double budgetMs);
+
+        // True once every queued model is resident
+        bool isIdle();
+
+    private:
+        struct LoadRequest {
+            gps::Model3D* model;
+            std::string fileName;
+            PARSE_MODE parseMode;
+        };
+
+        std::vector<std::thread> workers;
+        std::mutex queueMutex;
+        std::condition_variable requestQueued;
+        // Waiting to be read by a worker
+        std::deque<LoadRequest> requests;
+        // Read, waiting to be uploaded by the render thread
+        std::deque<gps::Model3D*> readyModels;
+        size_t unfinishedCount;
+        bool stopping;
+        // A model is read with the cores no worker is using and no other model has taken, so the
+        // parse and decode threads running at once stay within the cores plus the pool's workers
+        unsigned int coreCount;
+        unsigned int busyWorkers;
+        unsigned int extraThreads;
+
+        void workerLoop();
+    };
+}
+
+#endif /* ModelLoader_hpp */
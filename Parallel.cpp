@@ -0,0 +1,33 @@
+#include "Parallel.hpp"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace gps {
+
+	void parallelFor(size_t count, const std::function<void(size_t)>& body, size_t maxThreads) {
+		size_t numThreads = maxThreads != 0 ? maxThreads : std::thread::hardware_concurrency();
+		if (numThreads > count) {
+			numThreads = count;
+		}
+
+		// Work is handed out one index at a time, so a few slow items don't leave threads idle
+		std::atomic<size_t> next(0);
+		auto worker = [&]() {
+			for (size_t i = next++; i < count; i = next++) {
+				body(i);
+			}
+		};
+
+		std::vector<std::thread> threads;
+		for (size_t t = 1; t < numThreads; t++) {
+			threads.push_back(std::thread(worker));
+		}
+		worker();
+
+		for (size_t t = 0; t < threads.size(); t++) {
+			threads[t].join();
+		}
+	}
+}
@@ -0,0 +1,14 @@
+#ifndef Parallel_hpp
+#define Parallel_hpp
+
+#include <cstddef>
+#include <functional>
+
+namespace gps {
+
+    // Calls body(i) for every i in [0, count) on up to maxThreads threads (one per core if 0),
+    // the calling thread included, and returns once all calls have finished
+    void parallelFor(size_t count, const std::function<void(size_t)>& body, size_t maxThreads = 0);
+}
+
+#endif /* Parallel_hpp */
@@ -0,0 +1,203 @@
+#include "PointShadowMap.hpp"
+#include "GLState.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cstdio>
+
+namespace gps {
+
+	const UniformName FACE_MATRIX_NAMES[6] = {
+		"faceMatrices[0]", "faceMatrices[1]", "faceMatrices[2]", "faceMatrices[3]", "faceMatrices[4]", "faceMatrices[5]"
+	};
+	const UniformName POINT_SHADOW_POSITION_NAMES[MAX_POINT_SHADOWS] = {
+		"pointShadowPositions[0]", "pointShadowPositions[1]", "pointShadowPositions[2]", "pointShadowPositions[3]"
+	};
+	const UniformName POINT_SHADOW_RADIUS_NAMES[MAX_POINT_SHADOWS] = {
+		"pointShadowRadii[0]", "pointShadowRadii[1]", "pointShadowRadii[2]", "pointShadowRadii[3]"
+	};
+
+	// Directions and up vectors of the cube map faces, in the order of their layers
+	const glm::vec3 FACE_DIRECTIONS[6] = {
+		glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f),
+		glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f)
+	};
+	const glm::vec3 FACE_UPS[6] = {
+		glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f),
+		glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)
+	};
+
+	PointShadowMap::PointShadowMap() : lightCount(0), frame(0), updatesLeft(0), updateCount(0) {
+		settings.maxLights = 0;
+		settings.resolution = 0;
+		settings.updatesPerFrame = 0;
+	}
+
+	void PointShadowMap::init(const PointShadowSettings& shadowSettings) {
+		GLint maxSize = 0;
+		glGetIntegerv(GL_MAX_CUBE_MAP_TEXTURE_SIZE, &maxSize);
+		settings = shadowSettings;
+		settings.maxLights = std::min(std::max(settings.maxLights, 1), MAX_POINT_SHADOWS);
+		settings.resolution = std::min(std::max(settings.resolution, (GLsizei)64), (GLsizei)maxSize);
+		settings.updatesPerFrame = std::max(settings.updatesPerFrame, 1);
+
+		GLuint framebufferId;
+		GLuint textureId;
+		glGenFramebuffers(1, &framebufferId);
+		glGenTextures(1, &textureId);
+		framebuffer.reset(framebufferId);
+		cubeArray.reset(textureId);
+
+		GLState& state = GLState::getInstance();
+		state.bindTexture(0, GL_TEXTURE_CUBE_MAP_ARRAY, cubeArray.get());
+		glTexImage3D(GL_TEXTURE_CUBE_MAP_ARRAY, 0, GL_DEPTH_COMPONENT24, settings.resolution, settings.resolution, 6 * settings.maxLights,
+			0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+		// Only read through samplerCubeArrayShadow, so the comparison is set on the texture
+		glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+		// Filter across the face edges too
+		glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+		state.bindFramebuffer(framebuffer.get());
+		glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, cubeArray.get(), 0);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+		state.bindFramebuffer(0);
+
+		lightCount = 0;
+		frame = 0;
+		updateCount = 0;
+
+		printf("Point shadows  : %d cubes of %dx%d, at most %d redrawn per frame\n", settings.maxLights, settings.resolution,
+			settings.resolution, settings.updatesPerFrame);
+	}
+
+	void PointShadowMap::reset() {
+		framebuffer.reset();
+		cubeArray.reset();
+		lightCount = 0;
+	}
+
+	int PointShadowMap::addLight(const glm::vec3& position, float radius) {
+		if (lightCount >= settings.maxLights) {
+			return -1;
+		}
+		Light& light = lights[lightCount];
+		light.position = position;
+		light.radius = radius;
+		light.dirty = true;
+		light.staticRevision = 0;
+		light.drawnFrame = 0;
+		return lightCount++;
+	}
+
+	void PointShadowMap::setLightPosition(int light, const glm::vec3& position) {
+		if (light >= 0 && light < lightCount && lights[light].position != position) {
+			lights[light].position = position;
+			lights[light].dirty = true;
+		}
+	}
+
+	int PointShadowMap::getLightCount() const {
+		return lightCount;
+	}
+
+	const glm::vec3& PointShadowMap::getLightPosition(int light) const {
+		return lights[light].position;
+	}
+
+	float PointShadowMap::getLightRadius(int light) const {
+		return lights[light].radius;
+	}
+
+	gps::Frustum PointShadowMap::getLightRange(int light) const {
+		float radius = lights[light].radius;
+		return gps::Frustum(glm::ortho(-radius, radius, -radius, radius, -radius, radius) *
+			glm::translate(glm::mat4(1.0f), -lights[light].position));
+	}
+
+	void PointShadowMap::beginFrame(uint32_t staticRevision) {
+		frame++;
+		updatesLeft = settings.updatesPerFrame;
+		for (int i = 0; i < lightCount; i++) {
+			if (lights[i].staticRevision != staticRevision) {
+				lights[i].staticRevision = staticRevision;
+				lights[i].dirty = true;
+			}
+		}
+	}
+
+	void PointShadowMap::markDirty(int light) {
+		if (light >= 0 && light < lightCount) {
+			lights[light].dirty = true;
+		}
+	}
+
+	int PointShadowMap::nextUpdate() {
+		if (updatesLeft <= 0) {
+			return -1;
+		}
+		int next = -1;
+		for (int i = 0; i < lightCount; i++) {
+			if (lights[i].dirty && (next < 0 || lights[i].drawnFrame < lights[next].drawnFrame)) {
+				next = i;
+			}
+		}
+		if (next >= 0) {
+			lights[next].dirty = false;
+			lights[next].drawnFrame = frame;
+			updatesLeft--;
+			updateCount++;
+		}
+		return next;
+	}
+
+	void PointShadowMap::beginLight(int light, gps::Shader& shader) {
+		GLState& state = GLState::getInstance();
+		state.bindFramebuffer(framebuffer.get());
+		state.viewport(0, 0, settings.resolution, settings.resolution);
+
+		// A layered clear would wipe every cube, so the light's six layers are cleared one by one
+		GLint layerBase = 6 * light;
+		for (int face = 0; face < 6; face++) {
+			glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, cubeArray.get(), 0, layerBase + face);
+			glClear(GL_DEPTH_BUFFER_BIT);
+		}
+		glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, cubeArray.get(), 0);
+
+		const Light& source = lights[light];
+		glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, 0.01f * source.radius, source.radius);
+		for (int face = 0; face < 6; face++) {
+			shader.setMat4(FACE_MATRIX_NAMES[face], projection * glm::lookAt(source.position, source.position + FACE_DIRECTIONS[face], FACE_UPS[face]));
+		}
+		shader.setInt("layerBase", layerBase);
+		shader.setVec3("lightPosition", source.position);
+		shader.setFloat("farPlane", source.radius);
+	}
+
+	void PointShadowMap::setUniforms(gps::Shader& shader, GLuint textureUnit) const {
+		GLState::getInstance().bindTexture(textureUnit, GL_TEXTURE_CUBE_MAP_ARRAY, cubeArray.get());
+		shader.setInt("pointShadowMaps", (GLint)textureUnit);
+		shader.setFloat("pointShadowResolution", (float)settings.resolution);
+		for (int i = 0; i < lightCount; i++) {
+			shader.setVec3(POINT_SHADOW_POSITION_NAMES[i], lights[i].position);
+			shader.setFloat(POINT_SHADOW_RADIUS_NAMES[i], lights[i].radius);
+		}
+	}
+
+	const gps::PointShadowSettings& PointShadowMap::getSettings() const {
+		return settings;
+	}
+
+	size_t PointShadowMap::takeUpdateCount() {
+		size_t count = updateCount;
+		updateCount = 0;
+		return count;
+	}
+}
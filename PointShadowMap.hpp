@@ -0,0 +1,91 @@
+#ifndef PointShadowMap_hpp
+#define PointShadowMap_hpp
+
+#include <GL/glew.h>
+#include "glm/glm.hpp"
+
+#include "Frustum.hpp"
+#include "GLHandle.hpp"
+#include "Shader.hpp"
+
+#include <cstdint>
+
+namespace gps {
+
+    // Size of the point shadow arrays in the shaders
+    const int MAX_POINT_SHADOWS = 4;
+
+    struct PointShadowSettings {
+        // Lights that get a cube, in the order they are added; the rest cast no shadows
+        int maxLights;
+        GLsizei resolution;
+        // Most cubes redrawn in one frame; the others wait for a later frame
+        int updatesPerFrame;
+    };
+
+    // Shadows of point lights, one depth cube per light in the cubes of a cube map array. A cube
+    // stores the distance to the light over its radius and is drawn in a single pass: a geometry
+    // shader sends each triangle to the faces it touches through gl_Layer. A cube is only redrawn
+    // when it is marked dirty: the light moved, the static casters changed or markDirty() was called
+    class PointShadowMap
+    {
+    public:
+        PointShadowMap();
+
+        // Creates the cube map array and the framebuffer; the count and resolution are clamped
+        void init(const PointShadowSettings& settings);
+        // Deletes the texture and framebuffer; call while the context still exists
+        void reset();
+
+        // Returns the light's cube index, or -1 if all cubes are taken
+        int addLight(const glm::vec3& position, float radius);
+        void setLightPosition(int light, const glm::vec3& position);
+        int getLightCount() const;
+        const glm::vec3& getLightPosition(int light) const;
+        float getLightRadius(int light) const;
+        // Box around the light's radius, for culling the casters that can reach it
+        gps::Frustum getLightRange(int light) const;
+
+        // Starts a frame; cubes drawn with another revision of the static casters become dirty
+        void beginFrame(uint32_t staticRevision);
+        // E.g. when a dynamic caster is in range
+        void markDirty(int light);
+        // Next dirty light to redraw this frame, the one waiting longest first, or -1 once
+        // none is left or updatesPerFrame cubes were redrawn
+        int nextUpdate();
+
+        // Binds the framebuffer, clears the light's cube and sets the shader's faceMatrices[],
+        // layerBase, lightPosition and farPlane; the casters in range are drawn next
+        void beginLight(int light, gps::Shader& shader);
+
+        // Binds the array to the unit, with depth comparison, and sets pointShadowMaps,
+        // pointShadowPositions[], pointShadowRadii[] and pointShadowResolution
+        void setUniforms(gps::Shader& shader, GLuint textureUnit) const;
+
+        const gps::PointShadowSettings& getSettings() const;
+        // Cubes redrawn since the last call
+        size_t takeUpdateCount();
+
+    private:
+        struct Light {
+            glm::vec3 position;
+            float radius;
+            bool dirty;
+            uint32_t staticRevision;
+            // Frame of the last redraw
+            uint64_t drawnFrame;
+        };
+
+        gps::PointShadowSettings settings;
+        gps::TextureHandle cubeArray;
+        gps::FramebufferHandle framebuffer;
+
+        Light lights[MAX_POINT_SHADOWS];
+        int lightCount;
+        uint64_t frame;
+        int updatesLeft;
+        size_t updateCount;
+    };
+}
+
+#endif /* PointShadowMap_hpp */
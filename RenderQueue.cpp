@@ -0,0 +1,103 @@
+#include "RenderQueue.hpp"
+
+#include <algorithm>
+
+namespace gps {
+
+	const int KEY_PASS_SHIFT = 56;
+	const int KEY_PROGRAM_SHIFT = 44;
+	const int KEY_MATERIAL_SHIFT = 24;
+	const uint64_t KEY_PROGRAM_MASK = (1u << 12) - 1;
+	const uint64_t KEY_MATERIAL_MASK = (1u << 20) - 1;
+	const uint64_t KEY_DEPTH_MASK = (1u << 24) - 1;
+
+	RenderQueue::RenderQueue() {
+		for (int pass = 0; pass < PASS_COUNT; pass++) {
+			passViews[pass].view = glm::mat4(1.0f);
+			passViews[pass].farPlane = 1.0f;
+		}
+	}
+
+	void RenderQueue::setPassView(RENDER_PASS pass, const glm::mat4& view, float farPlane) {
+		passViews[pass].view = view;
+		passViews[pass].farPlane = farPlane;
+	}
+
+	uint64_t RenderQueue::makeKey(RENDER_PASS pass, GLuint program, uint32_t material, float depth, float farPlane) {
+		// Nearer items get smaller keys; anything behind the camera or past the far plane is clamped
+		float scaledDepth = std::min(std::max(depth / farPlane, 0.0f), 1.0f);
+		uint64_t depthBits = (uint64_t)(scaledDepth * KEY_DEPTH_MASK);
+
+		return ((uint64_t)pass << KEY_PASS_SHIFT)
+			| (((uint64_t)program & KEY_PROGRAM_MASK) << KEY_PROGRAM_SHIFT)
+			| (((uint64_t)material & KEY_MATERIAL_MASK) << KEY_MATERIAL_SHIFT)
+			| depthBits;
+	}
+
+	void RenderQueue::submit(RENDER_PASS pass, gps::Shader& shader, gps::Model3D& model, const glm::mat4& transform, const glm::mat3& normalMatrix,
+		const uint8_t* visibleBatches) {
+		size_t batchCount = model.getBatchCount();
+		if (batchCount == 0) {
+			return;
+		}
+
+		size_t transformIndex = transforms.size();
+		transforms.push_back(transform);
+		normalMatrices.push_back(normalMatrix);
+
+		glm::mat4 modelView = passViews[pass].view * transform;
+		for (size_t b = 0; b < batchCount; b++) {
+			if (visibleBatches != NULL && !visibleBatches[b]) {
+				continue;
+			}
+			const gps::DrawBatch& batch = model.getBatch(b);
+			glm::vec3 center = (batch.bounds.min + batch.bounds.max) * 0.5f;
+			float depth = -(modelView * glm::vec4(center, 1.0f)).z;
+
+			gps::DrawItem item;
+			item.key = makeKey(pass, shader.getProgram(), batch.materialId, depth, passViews[pass].farPlane);
+			item.shader = &shader;
+			item.model = &model;
+			item.batch = b;
+			item.transform = transformIndex;
+			items.push_back(item);
+		}
+	}
+
+	void RenderQueue::draw(RENDER_PASS pass) {
+		std::sort(items.begin(), items.end(), [](const gps::DrawItem& a, const gps::DrawItem& b) {
+			return a.key < b.key;
+		});
+
+		// The pass is in the top bits, so its items are contiguous once sorted
+		uint64_t passKey = (uint64_t)pass << KEY_PASS_SHIFT;
+		auto first = std::lower_bound(items.begin(), items.end(), passKey, [](const gps::DrawItem& item, uint64_t key) {
+			return item.key < key;
+		});
+
+		gps::Shader* currentShader = NULL;
+		size_t currentTransform = transforms.size();
+		auto item = first;
+		for (; item != items.end() && (item->key >> KEY_PASS_SHIFT) == (uint64_t)pass; ++item) {
+			if (item->shader != currentShader || item->transform != currentTransform) {
+				currentShader = item->shader;
+				currentTransform = item->transform;
+
+				currentShader->setMat4("model", transforms[item->transform]);
+				if (currentShader->getUniformLocation("normalMatrix") != -1) {
+					currentShader->setMat3("normalMatrix", normalMatrices[item->transform]);
+				}
+			}
+
+			item->model->Draw(*item->shader, item->batch);
+		}
+
+		items.erase(first, item);
+	}
+
+	void RenderQueue::clear() {
+		items.clear();
+		transforms.clear();
+		normalMatrices.clear();
+	}
+}
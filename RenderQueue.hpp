@@ -0,0 +1,67 @@
+#ifndef RenderQueue_hpp
+#define RenderQueue_hpp
+
+#include "Model3D.hpp"
+#include "Shader.hpp"
+
+#include "glm/glm.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace gps {
+
+    // Passes in the order they are drawn; the pass is the most significant part of the sort key
+    enum RENDER_PASS {PASS_SHADOW, PASS_OPAQUE, PASS_COUNT};
+
+    // One model batch to draw with the given shader and model matrix
+    struct DrawItem {
+        uint64_t key;
+        gps::Shader* shader;
+        gps::Model3D* model;
+        size_t batch;
+        size_t transform;
+    };
+
+    // Collects the draws of a frame and submits them sorted by a 64-bit key:
+    //   pass (8 bits) | program (12 bits) | material (20 bits) | view depth (24 bits)
+    // so each pass switches programs and textures as rarely as possible, and draws the
+    // batches sharing a program and material front to back for early depth rejection
+    class RenderQueue
+    {
+    public:
+        RenderQueue();
+
+        // Camera the items of a pass are sorted by, and the far plane their depth is scaled to
+        void setPassView(RENDER_PASS pass, const glm::mat4& view, float farPlane);
+
+        // Queues the batches of the model, only those with a nonzero entry in visibleBatches unless
+        // it is NULL; non-resident models are skipped. normalMatrix is the inverse transpose of the
+        // pass's view * transform (see TransformSystem)
+        void submit(RENDER_PASS pass, gps::Shader& shader, gps::Model3D& model, const glm::mat4& transform, const glm::mat3& normalMatrix,
+            const uint8_t* visibleBatches = NULL);
+
+        // Sorts and draws the queued items of one pass, setting "model" and, if the program
+        // has it, "normalMatrix" for each; the items are removed afterwards
+        void draw(RENDER_PASS pass);
+
+        // Drops every queued item; the storage is kept, so a steady frame does not allocate
+        void clear();
+
+    private:
+        struct PassView {
+            glm::mat4 view;
+            float farPlane;
+        };
+
+        PassView passViews[PASS_COUNT];
+        std::vector<gps::DrawItem> items;
+        std::vector<glm::mat4> transforms;
+        std::vector<glm::mat3> normalMatrices;
+
+        static uint64_t makeKey(RENDER_PASS pass, GLuint program, uint32_t material, float depth, float farPlane);
+    };
+}
+
+#endif /* RenderQueue_hpp */
@@ -0,0 +1,473 @@
+#include "Scene.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace gps {
+
+	// Below this many entities the linear SSE sphere test culls faster than the BVH; measured
+	// with Project.exe --bench-bvh
+	const size_t BVH_CULL_MIN_ENTITIES = 2048;
+
+	// Box around the box transformed by the matrix
+	static gps::BoundingBox transformBox(const gps::BoundingBox& box, const glm::mat4& transform) {
+		glm::vec3 center = glm::vec3(transform * glm::vec4((box.min + box.max) * 0.5f, 1.0f));
+		glm::vec3 halfSize = (box.max - box.min) * 0.5f;
+		glm::vec3 extent = glm::abs(glm::vec3(transform[0])) * halfSize.x
+			+ glm::abs(glm::vec3(transform[1])) * halfSize.y
+			+ glm::abs(glm::vec3(transform[2])) * halfSize.z;
+
+		gps::BoundingBox result;
+		result.min = center - extent;
+		result.max = center + extent;
+		return result;
+	}
+
+	// Exactly the value once the channel stops, so a still entity keeps the same matrix at any alpha
+	static float blendChannel(const gps::SceneChannel& channel, float alpha) {
+		return channel.previous == channel.value ? channel.value : glm::mix(channel.previous, channel.value, alpha);
+	}
+
+	Scene::Scene() : bvhStale(false), bvhMoved(false), staticRevision(0) {
+	}
+
+	bool Scene::load(const std::string& fileName, gps::ModelLoader& loader) {
+		std::ifstream file(fileName.c_str());
+		if (!file) {
+			fprintf(stderr, "ERROR: could not open scene %s\n", fileName.c_str());
+			return false;
+		}
+
+		bool valid = true;
+		std::string line;
+		int lineNumber = 0;
+		while (std::getline(file, line)) {
+			lineNumber++;
+			std::istringstream tokens(line);
+			std::string keyword;
+			if (!(tokens >> keyword) || keyword[0] == '#') {
+				continue;
+			}
+
+			bool lineValid = true;
+			if (keyword == "model") {
+				std::string name;
+				std::string path;
+				std::string option;
+				lineValid = (bool)(tokens >> name >> std::quoted(path)) && findModel(name) < 0;
+				PARSE_MODE parseMode = (tokens >> option) && option == "parallel" ? gps::PARSE_PARALLEL : gps::PARSE_MAPPED;
+
+				if (lineValid) {
+					models.push_back(std::unique_ptr<gps::Model3D>(new gps::Model3D()));
+					modelNames.push_back(name);
+					loader.loadModel(models.back().get(), path, parseMode);
+				}
+			}
+			else if (keyword == "channel") {
+				gps::SceneChannel channel;
+				channel.motion = gps::MOTION_NONE;
+				channel.min = 0.0f;
+				channel.max = 0.0f;
+				channel.target = 0.0f;
+				channel.step = 0.0f;
+				channel.active = false;
+				lineValid = (bool)(tokens >> channel.name >> channel.value) && findChannel(channel.name) < 0;
+				channel.previous = channel.value;
+
+				std::string motion;
+				if (lineValid && tokens >> motion) {
+					if (motion == "pingpong") {
+						channel.motion = gps::MOTION_PINGPONG;
+						channel.active = true;
+						lineValid = (bool)(tokens >> channel.min >> channel.max >> channel.step);
+					}
+					else if (motion == "toward") {
+						channel.motion = gps::MOTION_TOWARD;
+						lineValid = (bool)(tokens >> channel.target >> channel.step);
+					}
+					else {
+						lineValid = false;
+					}
+				}
+
+				if (lineValid) {
+					channels.push_back(channel);
+				}
+			}
+			else if (keyword == "entity") {
+				gps::SceneEntity entity;
+				entity.transform = glm::mat4(1.0f);
+				entity.moveAxis = glm::vec3(0.0f);
+				entity.moveChannel = -1;
+				entity.growChannel = -1;
+				entity.bounded = false;
+				entity.castsShadows = true;
+				entity.dynamic = false;
+
+				std::string modelName;
+				tokens >> modelName;
+				int model = findModel(modelName);
+				lineValid = model >= 0;
+				entity.model = (uint32_t)model;
+
+				// Applied in order, like successive glm::translate/rotate/scale calls
+				std::string operation;
+				while (lineValid && tokens >> operation) {
+					glm::vec3 v;
+					if (operation == "translate" && tokens >> v.x >> v.y >> v.z) {
+						entity.transform = glm::translate(entity.transform, v);
+					}
+					else if (operation == "scale" && tokens >> v.x >> v.y >> v.z) {
+						entity.transform = glm::scale(entity.transform, v);
+					}
+					else if (operation == "rotate") {
+						float degrees;
+						lineValid = (bool)(tokens >> degrees >> v.x >> v.y >> v.z);
+						if (lineValid) {
+							entity.transform = glm::rotate(entity.transform, glm::radians(degrees), v);
+						}
+					}
+					else if (operation == "move") {
+						std::string channel;
+						lineValid = (bool)(tokens >> channel >> v.x >> v.y >> v.z);
+						entity.moveChannel = findChannel(channel);
+						entity.moveAxis = v;
+						lineValid = lineValid && entity.moveChannel >= 0;
+					}
+					else if (operation == "noshadow") {
+						entity.castsShadows = false;
+					}
+					else if (operation == "grow") {
+						std::string channel;
+						lineValid = (bool)(tokens >> channel);
+						entity.growChannel = findChannel(channel);
+						lineValid = lineValid && entity.growChannel >= 0;
+					}
+					else {
+						lineValid = false;
+					}
+				}
+
+				if (lineValid) {
+					entity.dynamic = (entity.moveChannel >= 0 && channels[entity.moveChannel].motion != gps::MOTION_NONE) ||
+						(entity.growChannel >= 0 && channels[entity.growChannel].motion != gps::MOTION_NONE);
+					entities.push_back(entity);
+					transforms.add(entity.transform);
+				}
+			}
+			else if (keyword == "light") {
+				gps::SceneLight light;
+				light.position = glm::vec3(0.0f);
+				light.color = glm::vec3(1.0f);
+				light.radius = 0.0f;
+				light.castsShadows = false;
+
+				std::string operation;
+				while (lineValid && tokens >> operation) {
+					glm::vec3 v;
+					if (operation == "position" && tokens >> v.x >> v.y >> v.z) {
+						light.position = v;
+					}
+					else if (operation == "color" && tokens >> v.x >> v.y >> v.z) {
+						light.color = v;
+					}
+					else if (operation == "radius") {
+						lineValid = (bool)(tokens >> light.radius);
+					}
+					else if (operation == "shadow") {
+						light.castsShadows = true;
+					}
+					else {
+						lineValid = false;
+					}
+				}
+				lineValid = lineValid && light.radius > 0.0f;
+
+				if (lineValid) {
+					lights.push_back(light);
+				}
+			}
+			else {
+				lineValid = false;
+			}
+
+			if (!lineValid) {
+				fprintf(stderr, "ERROR: %s:%d: invalid or duplicate definition: %s\n", fileName.c_str(), lineNumber, line.c_str());
+				valid = false;
+			}
+		}
+
+		for (int pass = 0; pass < PASS_COUNT; pass++) {
+			visibility[pass].assign(entities.size(), 1);
+		}
+		for (size_t i = 0; i < entities.size(); i++) {
+			visibility[PASS_SHADOW][i] = entities[i].castsShadows ? 1 : 0;
+		}
+		entityBounds.resize(entities.size());
+		interpolate(1.0f);
+		for (size_t i = 0; i < entities.size(); i++) {
+			updateEntityBounds((uint32_t)i);
+		}
+		bvhStale = true;
+		bvhMoved = false;
+
+		printf("Scene          : %s: %zu models, %zu channels, %zu entities, %zu lights\n", fileName.c_str(), models.size(), channels.size(),
+			entities.size(), lights.size());
+		return valid;
+	}
+
+	void Scene::reset() {
+		for (size_t i = 0; i < models.size(); i++) {
+			models[i]->reset();
+		}
+	}
+
+	void Scene::update() {
+		for (size_t i = 0; i < channels.size(); i++) {
+			gps::SceneChannel& channel = channels[i];
+			channel.previous = channel.value;
+			if (!channel.active) {
+				continue;
+			}
+
+			channel.value += channel.step;
+			if (channel.motion == gps::MOTION_PINGPONG) {
+				// Turn around at either end
+				if (channel.value >= channel.max) {
+					channel.value = channel.max;
+					channel.step = -std::fabs(channel.step);
+				}
+				else if (channel.value <= channel.min) {
+					channel.value = channel.min;
+					channel.step = std::fabs(channel.step);
+				}
+			}
+			else if (channel.motion == gps::MOTION_TOWARD) {
+				if (channel.step < 0.0f ? channel.value <= channel.target : channel.value >= channel.target) {
+					channel.active = false;
+				}
+			}
+		}
+	}
+
+	void Scene::interpolate(float alpha) {
+		movedCasters.clear();
+		movedFrom.clear();
+		updateResidentEntities();
+		for (size_t i = 0; i < entities.size(); i++) {
+			const gps::SceneEntity& entity = entities[i];
+			if (entity.moveChannel < 0 && entity.growChannel < 0) {
+				continue;
+			}
+
+			glm::mat4 world = entity.transform;
+			if (entity.moveChannel >= 0) {
+				const gps::SceneChannel& channel = channels[entity.moveChannel];
+				world = glm::translate(world, entity.moveAxis * blendChannel(channel, alpha));
+			}
+			if (entity.growChannel >= 0) {
+				const gps::SceneChannel& channel = channels[entity.growChannel];
+				world = glm::scale(world, glm::vec3(1.0f + blendChannel(channel, alpha)));
+			}
+			// Channels that stopped, or have not started, leave the matrix as it was
+			if (world == transforms.getWorld((uint32_t)i)) {
+				continue;
+			}
+			if (entity.castsShadows && entity.bounded) {
+				movedCasters.push_back((uint32_t)i);
+				movedFrom.push_back(entityBounds[i]);
+			}
+			transforms.setWorld((uint32_t)i, world);
+			if (!entityBounds.empty()) {
+				updateEntityBounds((uint32_t)i);
+				bvhMoved = true;
+			}
+		}
+	}
+
+	void Scene::computeNormalMatrices(const glm::mat4& view) {
+		transforms.computeNormalMatrices(view);
+	}
+
+	size_t Scene::cull(RENDER_PASS pass, const gps::Frustum& frustum, ENTITY_SET set) {
+		updateResidentEntities();
+		cullFrusta[pass] = frustum;
+
+		size_t visibleCount;
+		if (entities.size() >= BVH_CULL_MIN_ENTITIES) {
+			updateBvh();
+			bvhResults.clear();
+			bvh.queryFrustum(frustum, bvhResults);
+			std::fill(visibility[pass].begin(), visibility[pass].end(), (uint8_t)0);
+			for (size_t i = 0; i < bvhResults.size(); i++) {
+				visibility[pass][bvhResults[i]] = 1;
+			}
+			visibleCount = bvhResults.size();
+		}
+		else {
+			visibleCount = transforms.cull(frustum, visibility[pass]);
+		}
+		if (pass == PASS_SHADOW || set != ENTITIES_ALL) {
+			for (size_t i = 0; i < entities.size(); i++) {
+				const gps::SceneEntity& entity = entities[i];
+				bool excluded = (pass == PASS_SHADOW && !entity.castsShadows) ||
+					(set == ENTITIES_STATIC && entity.dynamic) || (set == ENTITIES_DYNAMIC && !entity.dynamic);
+				if (excluded && visibility[pass][i]) {
+					visibility[pass][i] = 0;
+					visibleCount--;
+				}
+			}
+		}
+		return visibleCount;
+	}
+
+	size_t Scene::countMovedCasters(const gps::Frustum& frustum) {
+		size_t count = 0;
+		for (size_t i = 0; i < movedCasters.size(); i++) {
+			if (frustum.intersects(movedFrom[i]) || frustum.intersects(entityBounds[movedCasters[i]])) {
+				count++;
+			}
+		}
+		return count;
+	}
+
+	size_t Scene::getEntityCount() {
+		return entities.size();
+	}
+
+	uint32_t Scene::getStaticRevision() {
+		return staticRevision;
+	}
+
+	const std::vector<gps::SceneLight>& Scene::getLights() {
+		return lights;
+	}
+
+	const std::string& Scene::getEntityModelName(uint32_t entity) {
+		return modelNames[entities[entity].model];
+	}
+
+	int Scene::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float* hitDistance) {
+		updateBvh();
+		return bvh.raycast(origin, direction, maxDistance, hitDistance);
+	}
+
+	void Scene::findOverlapping(const gps::BoundingBox& box, std::vector<uint32_t>& found) {
+		updateBvh();
+		bvh.queryOverlap(box, found);
+	}
+
+	void Scene::updateResidentEntities() {
+		// Models finish loading in the background; their entities stay unbounded until then
+		for (size_t i = 0; i < entities.size(); i++) {
+			gps::SceneEntity& entity = entities[i];
+			if (!entity.bounded && models[entity.model]->isResident()) {
+				transforms.setBounds((uint32_t)i, models[entity.model]->getBoundingSphere());
+				entity.bounded = true;
+				updateEntityBounds((uint32_t)i);
+				bvhStale = true;
+				if (!entity.dynamic) {
+					staticRevision++;
+				}
+				else if (entity.castsShadows) {
+					movedCasters.push_back((uint32_t)i);
+					movedFrom.push_back(entityBounds[i]);
+				}
+			}
+		}
+	}
+
+	void Scene::updateEntityBounds(uint32_t entity) {
+		const glm::mat4& world = transforms.getWorld(entity);
+		if (entities[entity].bounded) {
+			entityBounds[entity] = transformBox(models[entities[entity].model]->getBounds(), world);
+		}
+		else {
+			entityBounds[entity].min = glm::vec3(world[3]);
+			entityBounds[entity].max = glm::vec3(world[3]);
+		}
+	}
+
+	void Scene::updateBvh() {
+		if (bvhStale) {
+			bvh.build(entityBounds);
+			bvhStale = false;
+			bvhMoved = false;
+		}
+		else if (bvhMoved) {
+			bvh.refit(entityBounds);
+			bvhMoved = false;
+		}
+	}
+
+	void Scene::submit(gps::RenderQueue& queue, RENDER_PASS pass, gps::Shader& shader) {
+		for (size_t i = 0; i < entities.size(); i++) {
+			if (!visibility[pass][i]) {
+				continue;
+			}
+			uint32_t index = (uint32_t)i;
+			gps::Model3D& model = *models[entities[i].model];
+			const glm::mat4& world = transforms.getWorld(index);
+
+			// Entities wholly inside the frustum, and those with one batch, already passed the cull
+			size_t batchCount = model.getBatchCount();
+			const gps::Frustum& frustum = cullFrusta[pass];
+			if (batchCount < 2 || !entities[i].bounded || frustum.contains(entityBounds[i])) {
+				queue.submit(pass, shader, model, world, transforms.getNormalMatrix(index));
+				continue;
+			}
+
+			batchVisibility.resize(batchCount);
+			bool anyVisible = false;
+			for (size_t b = 0; b < batchCount; b++) {
+				batchVisibility[b] = frustum.intersects(transformBox(model.getBatch(b).bounds, world)) ? 1 : 0;
+				anyVisible = anyVisible || batchVisibility[b];
+			}
+			if (anyVisible) {
+				queue.submit(pass, shader, model, world, transforms.getNormalMatrix(index), batchVisibility.data());
+			}
+		}
+	}
+
+	int Scene::findChannel(const std::string& name) {
+		for (size_t i = 0; i < channels.size(); i++) {
+			if (channels[i].name == name) {
+				return (int)i;
+			}
+		}
+		return -1;
+	}
+
+	float Scene::getChannelValue(int channel) {
+		return channel >= 0 ? channels[channel].value : 0.0f;
+	}
+
+	void Scene::setChannelValue(int channel, float value) {
+		if (channel >= 0) {
+			channels[channel].value = value;
+			channels[channel].previous = value;
+			staticRevision++;
+		}
+	}
+
+	void Scene::triggerChannel(int channel) {
+		if (channel >= 0 && channels[channel].motion == gps::MOTION_TOWARD) {
+			channels[channel].active = true;
+		}
+	}
+
+	int Scene::findModel(const std::string& name) {
+		for (size_t i = 0; i < modelNames.size(); i++) {
+			if (modelNames[i] == name) {
+				return (int)i;
+			}
+		}
+		return -1;
+	}
+}
@@ -0,0 +1,162 @@
+#ifndef Scene_hpp
+#define Scene_hpp
+
+#include "Bvh.hpp"
+#include "Frustum.hpp"
+#include "Model3D.hpp"
+#include "ModelLoader.hpp"
+#include "RenderQueue.hpp"
+#include "Shader.hpp"
+#include "TransformSystem.hpp"
+
+#include "glm/glm.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace gps {
+
+    // How a channel changes on every update: not at all (the application sets it), back and
+    // forth between two values, or towards a target once triggered
+    enum CHANNEL_MOTION {MOTION_NONE, MOTION_PINGPONG, MOTION_TOWARD};
+
+    // Which entities a cull lets through: all of them, or only those that never move on their own
+    // (static) or only those that do (dynamic)
+    enum ENTITY_SET {ENTITIES_ALL, ENTITIES_STATIC, ENTITIES_DYNAMIC};
+
+    // Animated value entities can follow
+    struct SceneChannel {
+        std::string name;
+        float value;
+        // Value before the last update, for interpolating between updates
+        float previous;
+        CHANNEL_MOTION motion;
+        // Range of MOTION_PINGPONG
+        float min;
+        float max;
+        // Where MOTION_TOWARD stops
+        float target;
+        float step;
+        bool active;
+    };
+
+    // One placed instance of a model; entities are stored contiguously and updated and
+    // submitted in a single linear pass. Entity i's world matrix is object i of the scene's
+    // TransformSystem; entities without channels keep the one computed at load
+    struct SceneEntity {
+        glm::mat4 transform;
+        glm::vec3 moveAxis;
+        int32_t moveChannel;
+        int32_t growChannel;
+        uint32_t model;
+        // Set once the model is resident and its bounds are known
+        bool bounded;
+        // False for pure receivers (e.g. the ground), which are left out of the shadow pass
+        bool castsShadows;
+        // Follows a pingpong or toward channel, so it can move on any update
+        bool dynamic;
+    };
+
+    // Point light placed in the scene, in world space; it lights nothing beyond its radius
+    struct SceneLight {
+        glm::vec3 position;
+        glm::vec3 color;
+        float radius;
+        bool castsShadows;
+    };
+
+    // Models, animation channels, entities and lights read from a scene file (see scenes/main.scene)
+    class Scene
+    {
+    public:
+        Scene();
+
+        // Reads the scene file and queues its models on the loader; returns false if the file
+        // cannot be read or has errors (which are printed)
+        bool load(const std::string& fileName, gps::ModelLoader& loader);
+        // Releases the models' textures and meshes; call while the context still exists, after
+        // the loader has stopped
+        void reset();
+
+        // Advances the animated channels by one fixed step; call once per simulation tick
+        void update();
+
+        // Recomputes the world matrices of the animated entities from the channel values blended
+        // between the last two updates, alpha = 0 being the previous update and 1 the latest one
+        void interpolate(float alpha);
+
+        // Computes the normal matrices the next submit() passes on, for this view
+        void computeNormalMatrices(const glm::mat4& view);
+
+        // Tests the entities against the frustum; until the next cull of the same pass, submit()
+        // skips the ones outside it and those not in the set, and the batches outside it of the
+        // entities only partly inside. Non-casters never pass PASS_SHADOW. Returns how many
+        // entities are visible
+        size_t cull(RENDER_PASS pass, const gps::Frustum& frustum, ENTITY_SET set = ENTITIES_ALL);
+        // Counts the casters that moved at the last interpolate(), or became resident, with the box
+        // they left or the one they are in intersecting the frustum
+        size_t countMovedCasters(const gps::Frustum& frustum);
+        size_t getEntityCount();
+        // Changes whenever a static entity may look different: when its model finishes loading
+        // or a channel is set. Depth cached from the static entities is valid while it stays the same
+        uint32_t getStaticRevision();
+        const std::string& getEntityModelName(uint32_t entity);
+
+        // Nearest entity whose world box the ray hits within maxDistance, or -1 (see Bvh::raycast)
+        int raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float* hitDistance);
+        // Appends the entities whose world box overlaps the box
+        void findOverlapping(const gps::BoundingBox& box, std::vector<uint32_t>& found);
+
+        const std::vector<gps::SceneLight>& getLights();
+
+        // Queues every entity for the pass, except those culled and those of models still loading
+        void submit(gps::RenderQueue& queue, RENDER_PASS pass, gps::Shader& shader);
+
+        // Index of the channel with this name, or -1; the other channel functions ignore -1
+        int findChannel(const std::string& name);
+        float getChannelValue(int channel);
+        // Sets the channel immediately, without interpolating from the old value
+        void setChannelValue(int channel, float value);
+        // Starts a MOTION_TOWARD channel moving
+        void triggerChannel(int channel);
+
+    private:
+        // Model3D is not movable and the loader keeps pointers to it, so each one is allocated once
+        std::vector<std::unique_ptr<gps::Model3D>> models;
+        std::vector<std::string> modelNames;
+        std::vector<gps::SceneChannel> channels;
+        std::vector<gps::SceneEntity> entities;
+        std::vector<gps::SceneLight> lights;
+        gps::TransformSystem transforms;
+        // Per pass, 1 for each entity that passed the last cull; passes never culled draw every
+        // entity (every caster for PASS_SHADOW)
+        std::vector<uint8_t> visibility[PASS_COUNT];
+        // Per pass, the frustum of the last cull, which submit() tests the batches against
+        gps::Frustum cullFrusta[PASS_COUNT];
+        std::vector<uint8_t> batchVisibility;
+        // Casters whose world matrix changed at the last interpolate() (or that got their bounds),
+        // with their world boxes from before the change
+        std::vector<uint32_t> movedCasters;
+        std::vector<gps::BoundingBox> movedFrom;
+
+        // World boxes of the entities (a point at the origin of those still loading) and the
+        // tree over them, rebuilt when an entity gets its bounds and refit when entities move
+        std::vector<gps::BoundingBox> entityBounds;
+        gps::Bvh bvh;
+        bool bvhStale;
+        bool bvhMoved;
+        std::vector<uint32_t> bvhResults;
+        uint32_t staticRevision;
+
+        // Gives the entities of the models that finished loading their bounds
+        void updateResidentEntities();
+        void updateEntityBounds(uint32_t entity);
+        void updateBvh();
+
+        int findModel(const std::string& name);
+    };
+}
+
+#endif /* Scene_hpp */
@@ -1,7 +1,7 @@
 #include "Shader.hpp"
 
 namespace gps {
-    std::string Shader::readShaderFile(std::string fileName)
+    std::string Shader::readShaderFile(const std::string& fileName)
     {
         std::ifstream shaderFile;
         std::string shaderString;
@@ -44,47 +44,210 @@ namespace gps {
         //check linking info
         glGetProgramiv(shaderProgramId, GL_LINK_STATUS, &success);
         if(!success) {
-            glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
+            glGetProgramInfoLog(shaderProgramId, 512, NULL, infoLog);
             std::cout << "Shader linking error\n" << infoLog << std::endl;
         }
     }
 
-    void Shader::loadShader(std::string vertexShaderFileName, std::string fragmentShaderFileName)
+    void Shader::loadShader(const std::string& vertexShaderFileName, const std::string& fragmentShaderFileName)
     {
-        //read, parse and compile the vertex shader
-        std::string v = readShaderFile(vertexShaderFileName);
-        const GLchar* vertexShaderString = v.c_str();
-        GLuint vertexShader;
-        vertexShader = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertexShader, 1, &vertexShaderString, NULL);
-        glCompileShader(vertexShader);
-        //check compilation status
-        shaderCompileLog(vertexShader);
-
-        //read, parse and compile the vertex shader
-        std::string f = readShaderFile(fragmentShaderFileName);
-        const GLchar* fragmentShaderString = f.c_str();
-        GLuint fragmentShader;
-        fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragmentShader, 1, &fragmentShaderString, NULL);
-        glCompileShader(fragmentShader);
-        //check compilation status
-        shaderCompileLog(fragmentShader);
+        loadShader(vertexShaderFileName, std::string(), fragmentShaderFileName);
+    }
+
+    void Shader::loadShader(const std::string& vertexShaderFileName, const std::string& geometryShaderFileName, const std::string& fragmentShaderFileName)
+    {
+        //read, parse and compile the stages; the geometry shader is optional
+        GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexShaderFileName);
+        GLuint geometryShader = geometryShaderFileName.empty() ? 0 : compileShader(GL_GEOMETRY_SHADER, geometryShaderFileName);
+        GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentShaderFileName);
 
         //attach and link the shader programs
-        this->shaderProgram = glCreateProgram();
-        glAttachShader(this->shaderProgram, vertexShader);
-        glAttachShader(this->shaderProgram, fragmentShader);
-        glLinkProgram(this->shaderProgram);
+        this->shaderProgram.reset(glCreateProgram());
+        glAttachShader(this->shaderProgram.get(), vertexShader);
+        if (geometryShader != 0) {
+            glAttachShader(this->shaderProgram.get(), geometryShader);
+        }
+        glAttachShader(this->shaderProgram.get(), fragmentShader);
+        glLinkProgram(this->shaderProgram.get());
         glDeleteShader(vertexShader);
+        if (geometryShader != 0) {
+            glDeleteShader(geometryShader);
+        }
         glDeleteShader(fragmentShader);
         //check linking info
-        shaderLinkLog(this->shaderProgram);
+        shaderLinkLog(this->shaderProgram.get());
+
+        reflectUniforms();
+    }
+
+    GLuint Shader::compileShader(GLenum type, const std::string& fileName)
+    {
+        //each #include "file" line is replaced by that file, from the same directory, passed as
+        //a separate string; the #line directives keep the line numbers in the compile log right
+        std::string directory = fileName.substr(0, fileName.find_last_of('/') + 1);
+        std::istringstream stream(readShaderFile(fileName));
+        std::vector<std::string> sources(1);
+        std::string line;
+        int lineNumber = 1;
+        while (std::getline(stream, line)) {
+            if (line.compare(0, 10, "#include \"") == 0) {
+                std::string includeName = line.substr(10, line.find('"', 10) - 10);
+                sources.push_back("#line 1 " + std::to_string(sources.size() / 2 + 1) + "\n" + readShaderFile(directory + includeName) + "\n");
+                sources.push_back("#line " + std::to_string(lineNumber + 1) + " 0\n");
+            }
+            else {
+                sources.back() += line + "\n";
+            }
+            lineNumber++;
+        }
+
+        std::vector<const GLchar*> sourceStrings;
+        for (size_t i = 0; i < sources.size(); i++) {
+            sourceStrings.push_back(sources[i].c_str());
+        }
+        GLuint shader = glCreateShader(type);
+        glShaderSource(shader, (GLsizei)sourceStrings.size(), sourceStrings.data(), NULL);
+        glCompileShader(shader);
+        //check compilation status
+        shaderCompileLog(shader);
+        return shader;
+    }
+
+    void Shader::reflectUniforms()
+    {
+        this->uniforms.clear();
+
+        GLint uniformCount = 0;
+        GLint maxNameLength = 0;
+        glGetProgramiv(this->shaderProgram.get(), GL_ACTIVE_UNIFORMS, &uniformCount);
+        glGetProgramiv(this->shaderProgram.get(), GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+        std::string nameBuffer(maxNameLength + 1, '\0');
+        for (GLint i = 0; i < uniformCount; i++) {
+            GLint size;
+            GLenum type;
+            glGetActiveUniform(this->shaderProgram.get(), (GLuint)i, (GLsizei)nameBuffer.size(), NULL, &size, &type, &nameBuffer[0]);
+            std::string name = nameBuffer.c_str();
+
+            Uniform uniform;
+            uniform.type = type;
+            uniform.hasValue = false;
+            memset(uniform.value, 0, sizeof(uniform.value));
+
+            // Arrays are reported as "name[0]"; register "name" and every element
+            std::string baseName = name;
+            if (size > 1 || (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)) {
+                baseName = name.substr(0, name.find_last_of('['));
+            }
+
+            std::vector<std::string> names;
+            names.push_back(baseName);
+            if (baseName != name || size > 1) {
+                for (GLint element = 0; element < size; element++) {
+                    names.push_back(baseName + "[" + std::to_string(element) + "]");
+                }
+            }
+
+            for (size_t n = 0; n < names.size(); n++) {
+                uniform.location = glGetUniformLocation(this->shaderProgram.get(), names[n].c_str());
+                if (uniform.location == -1) {
+                    continue;
+                }
+
+                uint32_t hash = hashUniformName(names[n].c_str());
+                if (this->uniforms.count(hash) > 0 && this->uniforms.at(hash).location != uniform.location) {
+                    std::cout << "Uniform name hash collision: " << names[n] << std::endl;
+                }
+                this->uniforms[hash] = uniform;
+            }
+        }
+    }
+
+    GLint Shader::getUniformLocation(UniformName name)
+    {
+        auto uniform = this->uniforms.find(name.hash);
+        return uniform == this->uniforms.end() ? -1 : uniform->second.location;
+    }
+
+    Uniform* Shader::changedUniform(UniformName name, const void* value, size_t size)
+    {
+        auto found = this->uniforms.find(name.hash);
+        if (found == this->uniforms.end()) {
+            return NULL;
+        }
+
+        Uniform* uniform = &found->second;
+        if (uniform->hasValue && memcmp(uniform->value, value, size) == 0) {
+            return NULL;
+        }
+
+        memcpy(uniform->value, value, size);
+        uniform->hasValue = true;
+        return uniform;
+    }
+
+    void Shader::setInt(UniformName name, GLint value)
+    {
+        Uniform* uniform = changedUniform(name, &value, sizeof(value));
+        if (uniform) {
+            glProgramUniform1i(this->shaderProgram.get(), uniform->location, value);
+        }
+    }
+
+    void Shader::setFloat(UniformName name, GLfloat value)
+    {
+        Uniform* uniform = changedUniform(name, &value, sizeof(value));
+        if (uniform) {
+            glProgramUniform1f(this->shaderProgram.get(), uniform->location, value);
+        }
+    }
+
+    void Shader::setVec2(UniformName name, const glm::vec2& value)
+    {
+        Uniform* uniform = changedUniform(name, glm::value_ptr(value), sizeof(value));
+        if (uniform) {
+            glProgramUniform2fv(this->shaderProgram.get(), uniform->location, 1, glm::value_ptr(value));
+        }
+    }
+
+    void Shader::setVec3(UniformName name, const glm::vec3& value)
+    {
+        Uniform* uniform = changedUniform(name, glm::value_ptr(value), sizeof(value));
+        if (uniform) {
+            glProgramUniform3fv(this->shaderProgram.get(), uniform->location, 1, glm::value_ptr(value));
+        }
+    }
+
+    void Shader::setMat3(UniformName name, const glm::mat3& value)
+    {
+        Uniform* uniform = changedUniform(name, glm::value_ptr(value), sizeof(value));
+        if (uniform) {
+            glProgramUniformMatrix3fv(this->shaderProgram.get(), uniform->location, 1, GL_FALSE, glm::value_ptr(value));
+        }
+    }
+
+    void Shader::setMat4(UniformName name, const glm::mat4& value)
+    {
+        Uniform* uniform = changedUniform(name, glm::value_ptr(value), sizeof(value));
+        if (uniform) {
+            glProgramUniformMatrix4fv(this->shaderProgram.get(), uniform->location, 1, GL_FALSE, glm::value_ptr(value));
+        }
+    }
+
+    void Shader::reset()
+    {
+        this->shaderProgram.reset();
+        this->uniforms.clear();
     }
 
     void Shader::useShaderProgram()
     {
-        glUseProgram(this->shaderProgram);
+        GLState::getInstance().useProgram(this->shaderProgram.get());
+    }
+
+    GLuint Shader::getProgram()
+    {
+        return this->shaderProgram.get();
     }
 
 }
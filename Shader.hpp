@@ -2,26 +2,89 @@
 #define Shader_hpp
 
 #include <GL/glew.h>
+#include "glm/glm.hpp"
+#include "glm/gtc/type_ptr.hpp"
 
+#include "GLHandle.hpp"
+
+#include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace gps {
 
+// FNV-1a hash of a uniform name; constexpr, so names written as literals are hashed by the compiler
+constexpr uint32_t hashUniformName(const char* name, uint32_t hash = 2166136261u) {
+    return *name == 0 ? hash : hashUniformName(name + 1, (hash ^ (uint32_t)(unsigned char)*name) * 16777619u);
+}
+
+struct UniformName {
+    uint32_t hash;
+    const char* name;
+
+    constexpr UniformName(const char* name) : hash(hashUniformName(name)), name(name) {}
+};
+
+// Active uniform found by reflection after linking, with the last value uploaded to it
+struct Uniform {
+    GLint location;
+    GLenum type;
+    bool hasValue;
+    GLfloat value[16];
+};
+
+// Owns its program, so it is move-only; pass it by reference
 class Shader
 {
 public:
-    GLuint shaderProgram;
-    void loadShader(std::string vertexShaderFileName, std::string fragmentShaderFileName);
+    Shader() = default;
+    Shader(const Shader&) = delete;
+    Shader& operator=(const Shader&) = delete;
+    Shader(Shader&&) = default;
+    Shader& operator=(Shader&&) = default;
+
+    // A line #include "file" in a stage inserts that file, read from the stage's directory
+    void loadShader(const std::string& vertexShaderFileName, const std::string& fragmentShaderFileName);
+    // With a geometry shader between the two
+    void loadShader(const std::string& vertexShaderFileName, const std::string& geometryShaderFileName, const std::string& fragmentShaderFileName);
     void useShaderProgram();
+    // Deletes the program; call while the context still exists
+    void reset();
+    GLuint getProgram();
+
+    // Location of an active uniform, or -1 if the program has none with that name
+    GLint getUniformLocation(UniformName name);
+
+    // Typed setters; they work whether or not the program is in use, and skip the upload
+    // when the value is the same as the last one set
+    void setInt(UniformName name, GLint value);
+    void setFloat(UniformName name, GLfloat value);
+    void setVec2(UniformName name, const glm::vec2& value);
+    void setVec3(UniformName name, const glm::vec3& value);
+    void setMat3(UniformName name, const glm::mat3& value);
+    void setMat4(UniformName name, const glm::mat4& value);
 
 private:
-    std::string readShaderFile(std::string fileName);
+    gps::ProgramHandle shaderProgram;
+    // Keyed by name hash
+    std::unordered_map<uint32_t, Uniform> uniforms;
+
+    std::string readShaderFile(const std::string& fileName);
+    GLuint compileShader(GLenum type, const std::string& fileName);
     void shaderCompileLog(GLuint shaderId);
     void shaderLinkLog(GLuint shaderProgramId);
+
+    // Records every active uniform of the linked program, array elements included
+    void reflectUniforms();
+
+    // Returns the uniform if the value differs from the last one set (and remembers it), NULL otherwise
+    Uniform* changedUniform(UniformName name, const void* value, size_t size);
 };
 
 }
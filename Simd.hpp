@@ -0,0 +1,19 @@
+#ifndef Simd_hpp
+#define Simd_hpp
+
+#include <cstddef>
+
+// SSE is always available on x64 and is the MSVC default (/arch:SSE2) on x86; code using
+// GPS_SSE keeps a scalar path for other targets
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define GPS_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace gps {
+
+    // Floats per SSE register; structure-of-arrays data is padded to a multiple of this
+    const size_t SIMD_LANES = 4;
+}
+
+#endif /* Simd_hpp */
@@ -10,69 +10,102 @@
 
 namespace gps {
     
-    SkyBox::SkyBox()
+    SkyBox::SkyBox() : cubemapTexture(0)
     {
         
     }
     
-    void SkyBox::Load(std::vector<const GLchar*> cubeMapFaces)
+    void SkyBox::Load(const std::vector<const GLchar*>& cubeMapFaces)
     {
         cubemapTexture = LoadSkyBoxTextures(cubeMapFaces);
         InitSkyBox();
     }
     
-    void SkyBox::Draw(gps::Shader shader, glm::mat4 viewMatrix, glm::mat4 projectionMatrix)
+    void SkyBox::Draw(gps::Shader& shader, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix)
     {
         shader.useShaderProgram();
         
         //set the view and projection matrices
         glm::mat4 transformedView = glm::mat4(glm::mat3(viewMatrix));
-        glUniformMatrix4fv(glGetUniformLocation(shader.shaderProgram, "view"), 1, GL_FALSE, glm::value_ptr(transformedView));
-        glUniformMatrix4fv(glGetUniformLocation(shader.shaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projectionMatrix));
+        shader.setMat4("view", transformedView);
+        shader.setMat4("projection", projectionMatrix);
         
-        glDepthFunc(GL_LEQUAL);
+        GLState& state = GLState::getInstance();
+        state.depthFunc(GL_LEQUAL);
         
-        glBindVertexArray(skyboxVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glUniform1i(glGetUniformLocation(shader.shaderProgram, "skybox"), 0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+        state.bindVertexArray(skyboxVAO.get());
+        shader.setInt("skybox", 0);
+        state.bindTexture(0, GL_TEXTURE_CUBE_MAP, cubemapTexture);
         glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
         
-        glDepthFunc(GL_LESS);
+        state.depthFunc(GL_LESS);
     }
     
-    GLuint SkyBox::LoadSkyBoxTextures(std::vector<const GLchar*> skyBoxFaces)
+    GLuint SkyBox::LoadSkyBoxTextures(const std::vector<const GLchar*>& skyBoxFaces)
     {
-        GLuint textureID;
-        glGenTextures(1, &textureID);
-        glActiveTexture(GL_TEXTURE0);
+        // the cube map is cached under all its face paths
+        const gps::SamplerSettings sampler = { GL_TEXTURE_CUBE_MAP, GL_CLAMP_TO_EDGE, GL_LINEAR, GL_LINEAR };
+        std::string cacheKey;
+        for(GLuint i = 0; i < skyBoxFaces.size(); i++)
+        {
+            cacheKey += gps::canonicalPath(skyBoxFaces[i]) + ";";
+        }
+        
+        GLuint cachedTextureID = gps::TextureCache::getInstance().acquire(cacheKey, sampler);
+        if (cachedTextureID != 0) {
+            return cachedTextureID;
+        }
         
-        int width,height, n;
-        unsigned char* image;
         int force_channels = 3;
+        std::vector<unsigned char*> images(skyBoxFaces.size());
+        std::vector<int> widths(skyBoxFaces.size());
+        std::vector<int> heights(skyBoxFaces.size());
+        
+        // decode all the faces at the same time, then upload them in order
+        auto decodeStart = std::chrono::high_resolution_clock::now();
+        gps::parallelFor(skyBoxFaces.size(), [&](size_t i) {
+            int n;
+            images[i] = stbi_load(skyBoxFaces[i], &widths[i], &heights[i], &n, force_channels);
+        });
+        std::chrono::duration<double, std::milli> decodeTime = std::chrono::high_resolution_clock::now() - decodeStart;
         
-        glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
         for(GLuint i = 0; i < skyBoxFaces.size(); i++)
         {
-            image = stbi_load(skyBoxFaces[i], &width, &height, &n, force_channels);
-            if (!image) {
+            if (!images[i]) {
                 fprintf(stderr, "ERROR: could not load %s\n", skyBoxFaces[i]);
+                for (GLuint j = 0; j < images.size(); j++) {
+                    stbi_image_free(images[j]);
+                }
                 return false;
             }
+        }
+        
+        auto uploadStart = std::chrono::high_resolution_clock::now();
+        GLuint textureID;
+        glGenTextures(1, &textureID);
+        
+        GLState::getInstance().bindTexture(0, GL_TEXTURE_CUBE_MAP, textureID);
+        size_t bytes = 0;
+        for(GLuint i = 0; i < skyBoxFaces.size(); i++)
+        {
             glTexImage2D(
                          GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0,
-                         GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image
+                         GL_RGB, widths[i], heights[i], 0, GL_RGB, GL_UNSIGNED_BYTE, images[i]
                          );
+            stbi_image_free(images[i]);
+            bytes += (size_t)widths[i] * heights[i] * 3;
         }
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+        GLState::getInstance().bindTexture(0, GL_TEXTURE_CUBE_MAP, 0);
+        std::chrono::duration<double, std::milli> uploadTime = std::chrono::high_resolution_clock::now() - uploadStart;
         
-        return textureID;
+        printf("Skybox : %d faces decoded in %.2f ms, uploaded in %.2f ms\n", (int)skyBoxFaces.size(), decodeTime.count(), uploadTime.count());
+        
+        return gps::TextureCache::getInstance().insert(cacheKey, sampler, textureID, bytes);
     }
     
     void SkyBox::InitSkyBox()
@@ -121,21 +154,33 @@ namespace gps {
             1.0f, -1.0f,  1.0f
         };
         
-        glGenVertexArrays(1, &(this->skyboxVAO));
-        glGenBuffers(1, &skyboxVBO);
+        GLuint vertexArray;
+        GLuint vertexBuffer;
+        glGenVertexArrays(1, &vertexArray);
+        glGenBuffers(1, &vertexBuffer);
+        this->skyboxVAO.reset(vertexArray);
+        this->skyboxVBO.reset(vertexBuffer);
         
-        glBindVertexArray(skyboxVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
+        GLState::getInstance().bindVertexArray(skyboxVAO.get());
+        glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO.get());
         glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
         
         glEnableVertexAttribArray(0);
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
         
-        glBindVertexArray(0);
+        GLState::getInstance().bindVertexArray(0);
     }
     
     GLuint SkyBox::GetTextureId()
     {
         return cubemapTexture;
     }
+
+    void SkyBox::reset()
+    {
+        gps::TextureCache::getInstance().release(cubemapTexture);
+        cubemapTexture = 0;
+        skyboxVAO.reset();
+        skyboxVBO.reset();
+    }
 }
@@ -10,7 +10,12 @@
 #define SkyBox_hpp
 
 #include <stdio.h>
+#include "GLHandle.hpp"
+#include "GLState.hpp"
 #include "Shader.hpp"
+#include "Parallel.hpp"
+#include "TextureCache.hpp"
+#include <chrono>
 #include <vector>
 #include "stb_image.h"
 #include "glm/glm.hpp"
@@ -21,14 +26,18 @@ namespace gps {
     {
     public:
         SkyBox();
-        void Load(std::vector<const GLchar*> cubeMapFaces);
-        void Draw(gps::Shader shader, glm::mat4 viewMatrix, glm::mat4 projectionMatrix);
+        void Load(const std::vector<const GLchar*>& cubeMapFaces);
+        void Draw(gps::Shader& shader, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix);
         GLuint GetTextureId();
+        // Releases the cube map to the texture cache and deletes the buffers; call while the
+        // context still exists
+        void reset();
     private:
-        GLuint skyboxVAO;
-        GLuint skyboxVBO;
+        gps::VertexArrayHandle skyboxVAO;
+        gps::BufferHandle skyboxVBO;
+        // Owned by the TextureCache, which counts the sky boxes using it
         GLuint cubemapTexture;
-        GLuint LoadSkyBoxTextures(std::vector<const GLchar*> cubeMapFaces);
+        GLuint LoadSkyBoxTextures(const std::vector<const GLchar*>& cubeMapFaces);
         void InitSkyBox();
     };
 }
@@ -0,0 +1,125 @@
+#include "TextureCache.hpp"
+#include "GLState.hpp"
+
+#include <cstdio>
+
+namespace gps {
+
+	TextureCache::TextureCache() {
+		hits = 0;
+		misses = 0;
+		residentBytes = 0;
+	}
+
+	TextureCache& TextureCache::getInstance() {
+		// Never destroyed: the global models release their textures during static destruction
+		static TextureCache* instance = new TextureCache();
+		return *instance;
+	}
+
+	GLuint TextureCache::acquire(std::string path, SamplerSettings sampler) {
+		std::lock_guard<std::mutex> lock(cacheMutex);
+
+		auto entry = entries.find(makeKey(path, sampler));
+		if (entry == entries.end()) {
+			return 0;
+		}
+
+		entry->second.references++;
+		hits++;
+		return entry->second.id;
+	}
+
+	GLuint TextureCache::insert(std::string path, SamplerSettings sampler, GLuint textureID, size_t bytes) {
+		std::lock_guard<std::mutex> lock(cacheMutex);
+
+		std::string key = makeKey(path, sampler);
+		auto entry = entries.find(key);
+		if (entry != entries.end()) {
+			// Decoded by two models at the same time - keep the first upload
+			GLState::getInstance().textureDeleted(textureID);
+			glDeleteTextures(1, &textureID);
+			entry->second.references++;
+			hits++;
+			return entry->second.id;
+		}
+
+		Entry newEntry;
+		newEntry.id = textureID;
+		newEntry.references = 1;
+		newEntry.bytes = bytes;
+		entries[key] = newEntry;
+		keysById[textureID] = key;
+
+		misses++;
+		residentBytes += bytes;
+		return textureID;
+	}
+
+	void TextureCache::release(GLuint textureID) {
+		std::lock_guard<std::mutex> lock(cacheMutex);
+
+		auto key = keysById.find(textureID);
+		if (key == keysById.end()) {
+			return;
+		}
+
+		auto entry = entries.find(key->second);
+		if (--entry->second.references > 0) {
+			return;
+		}
+
+		GLState::getInstance().textureDeleted(textureID);
+		glDeleteTextures(1, &textureID);
+		residentBytes -= entry->second.bytes;
+		entries.erase(entry);
+		keysById.erase(key);
+	}
+
+	void TextureCache::printStats() {
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		printf("Texture cache  : %zu hits, %zu misses, %zu textures, %zu KB resident\n",
+			hits, misses, entries.size(), residentBytes / 1024);
+	}
+
+	std::string TextureCache::makeKey(std::string path, SamplerSettings sampler) {
+		return canonicalPath(path) + "|" + std::to_string(sampler.target) + "|" + std::to_string(sampler.wrap) + "|" +
+			std::to_string(sampler.minFilter) + "|" + std::to_string(sampler.magFilter);
+	}
+
+	std::string canonicalPath(std::string path) {
+		std::vector<std::string> parts;
+		size_t start = 0;
+
+		while (start <= path.size()) {
+			size_t end = path.find_first_of("/\\", start);
+			if (end == std::string::npos) {
+				end = path.size();
+			}
+
+			std::string part = path.substr(start, end - start);
+			if (part == "..") {
+				if (!parts.empty() && parts.back() != "..") {
+					parts.pop_back();
+				}
+				else {
+					parts.push_back(part);
+				}
+			}
+			else if (!part.empty() && part != ".") {
+				parts.push_back(part);
+			}
+
+			start = end + 1;
+		}
+
+		std::string canonical = !path.empty() && (path[0] == '/' || path[0] == '\\') ? "/" : "";
+		for (size_t i = 0; i < parts.size(); i++) {
+			if (i > 0) {
+				canonical += "/";
+			}
+			canonical += parts[i];
+		}
+		return canonical;
+	}
+}
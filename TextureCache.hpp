@@ -0,0 +1,66 @@
+#ifndef TextureCache_hpp
+#define TextureCache_hpp
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace gps {
+
+    // Sampler state a texture is created with; the same image with different settings is a different texture
+    struct SamplerSettings {
+        GLenum target;
+        GLint wrap;
+        GLint minFilter;
+        GLint magFilter;
+    };
+
+    // Textures shared by every Model3D and the skybox, reference counted and keyed by
+    // canonical path plus sampler settings
+    class TextureCache
+    {
+    public:
+        static TextureCache& getInstance();
+
+        // Takes a reference to a resident texture and returns it, or returns 0 if it is not resident yet.
+        // Safe to call from any thread
+        GLuint acquire(std::string path, SamplerSettings sampler);
+
+        // Adds a texture the caller has just uploaded, holding one reference. If the same texture became
+        // resident meanwhile, the new copy is deleted and the resident one is returned instead
+        GLuint insert(std::string path, SamplerSettings sampler, GLuint textureID, size_t bytes);
+
+        // Drops a reference; the texture is deleted together with its last reference
+        void release(GLuint textureID);
+
+        void printStats();
+
+    private:
+        struct Entry {
+            GLuint id;
+            int references;
+            size_t bytes;
+        };
+
+        std::mutex cacheMutex;
+        std::unordered_map<std::string, Entry> entries;
+        std::unordered_map<GLuint, std::string> keysById;
+        size_t hits;
+        size_t misses;
+        size_t residentBytes;
+
+        TextureCache();
+
+        std::string makeKey(std::string path, SamplerSettings sampler);
+    };
+
+    // Resolves "." and ".." and uses forward slashes, e.g. "models/trees/../buildings\\rock.png"
+    // becomes "models/buildings/rock.png"
+    std::string canonicalPath(std::string path);
+}
+
+#endif /* TextureCache_hpp */
@@ -0,0 +1,385 @@
+#include "TextureCompressor.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+namespace gps {
+
+	// DDS file layout, as documented for DirectX. The cache stores its magic,
+	// version and the hash of the source image in dwReserved1, which other DDS
+	// readers ignore.
+	struct DDSPixelFormat {
+		uint32_t size;
+		uint32_t flags;
+		uint32_t fourCC;
+		uint32_t rgbBitCount;
+		uint32_t rBitMask;
+		uint32_t gBitMask;
+		uint32_t bBitMask;
+		uint32_t aBitMask;
+	};
+
+	struct DDSHeader {
+		uint32_t size;
+		uint32_t flags;
+		uint32_t height;
+		uint32_t width;
+		uint32_t pitchOrLinearSize;
+		uint32_t depth;
+		uint32_t mipMapCount;
+		uint32_t reserved1[11];
+		DDSPixelFormat pixelFormat;
+		uint32_t caps;
+		uint32_t caps2;
+		uint32_t caps3;
+		uint32_t caps4;
+		uint32_t reserved2;
+	};
+
+	const uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+	const uint32_t DDS_FOURCC_DXT1 = 0x31545844; // "DXT1"
+	const uint32_t DDS_FOURCC_DXT5 = 0x35545844; // "DXT5"
+	const uint32_t DDSD_REQUIRED_FLAGS = 0x1 | 0x2 | 0x4 | 0x1000; // caps, height, width, pixel format
+	const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+	const uint32_t DDSD_LINEARSIZE = 0x80000;
+	const uint32_t DDPF_FOURCC = 0x4;
+	const uint32_t DDSCAPS_COMPLEX = 0x8;
+	const uint32_t DDSCAPS_TEXTURE = 0x1000;
+	const uint32_t DDSCAPS_MIPMAP = 0x400000;
+
+	// Bump TEXTURE_CACHE_VERSION whenever the encoder or the mip filter changes
+	const uint32_t TEXTURE_CACHE_MAGIC = 0x54535047; // "GPST"
+	const uint32_t TEXTURE_CACHE_VERSION = 1;
+
+	// sRGB <-> linear tables, so the mip levels are averaged in linear space like glGenerateMipmap does for sRGB textures
+	struct SrgbTables {
+		float toLinear[256];
+		unsigned char toSrgb[4096];
+
+		SrgbTables() {
+			for (int i = 0; i < 256; i++) {
+				float c = i / 255.0f;
+				toLinear[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+			}
+			for (int i = 0; i < 4096; i++) {
+				float l = i / 4095.0f;
+				float c = l <= 0.0031308f ? l * 12.92f : 1.055f * powf(l, 1.0f / 2.4f) - 0.055f;
+				toSrgb[i] = (unsigned char)(c * 255.0f + 0.5f);
+			}
+		}
+	};
+
+	static const SrgbTables& srgbTables() {
+		static SrgbTables tables;
+		return tables;
+	}
+
+	// Halves an RGBA8 image with a 2x2 box filter; odd edges repeat the last row/column
+	static void downsampleLevel(const unsigned char* src, int width, int height, unsigned char* dst, int dstWidth, int dstHeight) {
+		const SrgbTables& tables = srgbTables();
+
+		for (int y = 0; y < dstHeight; y++) {
+			const unsigned char* row0 = src + (size_t)std::min(2 * y, height - 1) * width * 4;
+			const unsigned char* row1 = src + (size_t)std::min(2 * y + 1, height - 1) * width * 4;
+
+			for (int x = 0; x < dstWidth; x++) {
+				int x0 = std::min(2 * x, width - 1) * 4;
+				int x1 = std::min(2 * x + 1, width - 1) * 4;
+
+				for (int c = 0; c < 3; c++) {
+					float sum = tables.toLinear[row0[x0 + c]] + tables.toLinear[row0[x1 + c]] +
+						tables.toLinear[row1[x0 + c]] + tables.toLinear[row1[x1 + c]];
+					dst[c] = tables.toSrgb[(int)(sum * 0.25f * 4095.0f + 0.5f)];
+				}
+				dst[3] = (unsigned char)((row0[x0 + 3] + row0[x1 + 3] + row1[x0 + 3] + row1[x1 + 3] + 2) / 4);
+				dst += 4;
+			}
+		}
+	}
+
+	// Copies the 4x4 block at (blockX, blockY); pixels past the border repeat the edge
+	static void fetchBlock(const unsigned char* pixels, int width, int height, int blockX, int blockY, unsigned char block[64]) {
+		for (int y = 0; y < 4; y++) {
+			const unsigned char* row = pixels + (size_t)std::min(blockY * 4 + y, height - 1) * width * 4;
+			for (int x = 0; x < 4; x++) {
+				memcpy(block + (y * 4 + x) * 4, row + std::min(blockX * 4 + x, width - 1) * 4, 4);
+			}
+		}
+	}
+
+	static uint16_t packRgb565(const unsigned char color[3]) {
+		return (uint16_t)(((color[0] >> 3) << 11) | ((color[1] >> 2) << 5) | (color[2] >> 3));
+	}
+
+	static void unpackRgb565(uint16_t packed, int color[3]) {
+		int r = (packed >> 11) & 31;
+		int g = (packed >> 5) & 63;
+		int b = packed & 31;
+		color[0] = (r << 3) | (r >> 2);
+		color[1] = (g << 2) | (g >> 4);
+		color[2] = (b << 3) | (b >> 2);
+	}
+
+	// BC1 color block: the endpoints are the corners of the block's color bounding box, moved
+	// in by 1/16 of its size, and every pixel takes the nearest of the four palette colors
+	static void encodeColorBlock(const unsigned char block[64], unsigned char out[8]) {
+		unsigned char minColor[3] = { 255, 255, 255 };
+		unsigned char maxColor[3] = { 0, 0, 0 };
+		for (int i = 0; i < 16; i++) {
+			for (int c = 0; c < 3; c++) {
+				minColor[c] = std::min(minColor[c], block[i * 4 + c]);
+				maxColor[c] = std::max(maxColor[c], block[i * 4 + c]);
+			}
+		}
+		for (int c = 0; c < 3; c++) {
+			int inset = (maxColor[c] - minColor[c]) >> 4;
+			minColor[c] += inset;
+			maxColor[c] -= inset;
+		}
+
+		// Every channel of maxColor is >= minColor, so color0 >= color1 and the block uses the 4-color mode
+		uint16_t color0 = packRgb565(maxColor);
+		uint16_t color1 = packRgb565(minColor);
+		uint32_t indices = 0;
+
+		if (color0 != color1) {
+			int palette[4][3];
+			unpackRgb565(color0, palette[0]);
+			unpackRgb565(color1, palette[1]);
+			for (int c = 0; c < 3; c++) {
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+
+			for (int i = 0; i < 16; i++) {
+				int best = 0;
+				int bestDistance = 1 << 30;
+				for (int p = 0; p < 4; p++) {
+					int dr = block[i * 4 + 0] - palette[p][0];
+					int dg = block[i * 4 + 1] - palette[p][1];
+					int db = block[i * 4 + 2] - palette[p][2];
+					int distance = dr * dr + dg * dg + db * db;
+					if (distance < bestDistance) {
+						bestDistance = distance;
+						best = p;
+					}
+				}
+				indices |= (uint32_t)best << (2 * i);
+			}
+		}
+
+		out[0] = (unsigned char)(color0 & 255);
+		out[1] = (unsigned char)(color0 >> 8);
+		out[2] = (unsigned char)(color1 & 255);
+		out[3] = (unsigned char)(color1 >> 8);
+		for (int b = 0; b < 4; b++) {
+			out[4 + b] = (unsigned char)((indices >> (8 * b)) & 255);
+		}
+	}
+
+	// BC3 alpha block: the block's alpha range split into 8 levels, 3 bits per pixel
+	static void encodeAlphaBlock(const unsigned char block[64], unsigned char out[8]) {
+		int minAlpha = 255;
+		int maxAlpha = 0;
+		for (int i = 0; i < 16; i++) {
+			minAlpha = std::min(minAlpha, (int)block[i * 4 + 3]);
+			maxAlpha = std::max(maxAlpha, (int)block[i * 4 + 3]);
+		}
+
+		uint64_t indices = 0;
+		if (maxAlpha != minAlpha) {
+			// alpha0 > alpha1 selects the 8-level mode
+			int palette[8];
+			palette[0] = maxAlpha;
+			palette[1] = minAlpha;
+			for (int i = 1; i < 7; i++) {
+				palette[i + 1] = ((7 - i) * maxAlpha + i * minAlpha) / 7;
+			}
+
+			for (int i = 0; i < 16; i++) {
+				int best = 0;
+				int bestDistance = 256;
+				for (int p = 0; p < 8; p++) {
+					int distance = abs(block[i * 4 + 3] - palette[p]);
+					if (distance < bestDistance) {
+						bestDistance = distance;
+						best = p;
+					}
+				}
+				indices |= (uint64_t)best << (3 * i);
+			}
+		}
+
+		out[0] = (unsigned char)maxAlpha;
+		out[1] = (unsigned char)minAlpha;
+		for (int b = 0; b < 6; b++) {
+			out[2 + b] = (unsigned char)((indices >> (8 * b)) & 255);
+		}
+	}
+
+	size_t compressedLevelSize(GLenum format, int width, int height) {
+		size_t blockSize = format == GL_COMPRESSED_SRGB_S3TC_DXT1_EXT ? 8 : 16;
+		return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockSize;
+	}
+
+	void compressTexture(const unsigned char* pixels, int width, int height, CompressedTexture* texture) {
+		bool translucent = false;
+		for (size_t i = 0; i < (size_t)width * height; i++) {
+			if (pixels[i * 4 + 3] != 255) {
+				translucent = true;
+				break;
+			}
+		}
+
+		texture->format = translucent ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_SRGB_S3TC_DXT1_EXT;
+		texture->width = width;
+		texture->height = height;
+		texture->levels = 0;
+		texture->data.clear();
+
+		// Every level down to 1x1, like glGenerateMipmap
+		const unsigned char* level = pixels;
+		int levelWidth = width;
+		int levelHeight = height;
+		std::vector<unsigned char> levelPixels;
+		std::vector<unsigned char> nextLevelPixels;
+
+		while (true) {
+			size_t offset = texture->data.size();
+			texture->data.resize(offset + compressedLevelSize(texture->format, levelWidth, levelHeight));
+			unsigned char* out = &texture->data[offset];
+
+			unsigned char block[64];
+			for (int blockY = 0; blockY < (levelHeight + 3) / 4; blockY++) {
+				for (int blockX = 0; blockX < (levelWidth + 3) / 4; blockX++) {
+					fetchBlock(level, levelWidth, levelHeight, blockX, blockY, block);
+					if (translucent) {
+						encodeAlphaBlock(block, out);
+						out += 8;
+					}
+					encodeColorBlock(block, out);
+					out += 8;
+				}
+			}
+			texture->levels++;
+
+			if (levelWidth == 1 && levelHeight == 1) {
+				break;
+			}
+
+			int nextWidth = std::max(1, levelWidth / 2);
+			int nextHeight = std::max(1, levelHeight / 2);
+			nextLevelPixels.resize((size_t)nextWidth * nextHeight * 4);
+			downsampleLevel(level, levelWidth, levelHeight, nextLevelPixels.data(), nextWidth, nextHeight);
+
+			levelPixels.swap(nextLevelPixels);
+			level = levelPixels.data();
+			levelWidth = nextWidth;
+			levelHeight = nextHeight;
+		}
+	}
+
+	bool readDDS(std::string fileName, uint64_t sourceHash, CompressedTexture* texture) {
+		std::ifstream file(fileName.c_str(), std::ios::binary | std::ios::ate);
+		if (!file) {
+			return false;
+		}
+		size_t fileSize = (size_t)file.tellg();
+		file.seekg(0);
+
+		uint32_t magic;
+		DDSHeader header;
+		if (fileSize < sizeof(magic) + sizeof(header) ||
+			!file.read((char*)&magic, sizeof(magic)) ||
+			!file.read((char*)&header, sizeof(header))) {
+			return false;
+		}
+
+		uint64_t storedHash;
+		memcpy(&storedHash, &header.reserved1[2], sizeof(storedHash));
+		if (magic != DDS_MAGIC || header.size != sizeof(DDSHeader) ||
+			header.reserved1[0] != TEXTURE_CACHE_MAGIC ||
+			header.reserved1[1] != TEXTURE_CACHE_VERSION ||
+			storedHash != sourceHash ||
+			!(header.pixelFormat.flags & DDPF_FOURCC) ||
+			header.width == 0 || header.height == 0 || header.mipMapCount == 0) {
+			return false;
+		}
+
+		if (header.pixelFormat.fourCC == DDS_FOURCC_DXT1) {
+			texture->format = GL_COMPRESSED_SRGB_S3TC_DXT1_EXT;
+		}
+		else if (header.pixelFormat.fourCC == DDS_FOURCC_DXT5) {
+			texture->format = GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT;
+		}
+		else {
+			return false;
+		}
+
+		texture->width = (int)header.width;
+		texture->height = (int)header.height;
+		texture->levels = (int)header.mipMapCount;
+
+		size_t dataSize = 0;
+		int levelWidth = texture->width;
+		int levelHeight = texture->height;
+		for (int i = 0; i < texture->levels; i++) {
+			dataSize += compressedLevelSize(texture->format, levelWidth, levelHeight);
+			levelWidth = std::max(1, levelWidth / 2);
+			levelHeight = std::max(1, levelHeight / 2);
+		}
+		if (fileSize - sizeof(magic) - sizeof(header) < dataSize) {
+			return false;
+		}
+
+		texture->data.resize(dataSize);
+		if (!file.read((char*)texture->data.data(), dataSize)) {
+			texture->levels = 0;
+			texture->data.clear();
+			return false;
+		}
+
+		return true;
+	}
+
+	bool writeDDS(std::string fileName, uint64_t sourceHash, const CompressedTexture& texture) {
+		DDSHeader header;
+		memset(&header, 0, sizeof(header));
+		header.size = sizeof(DDSHeader);
+		header.flags = DDSD_REQUIRED_FLAGS | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+		header.height = (uint32_t)texture.height;
+		header.width = (uint32_t)texture.width;
+		header.pitchOrLinearSize = (uint32_t)compressedLevelSize(texture.format, texture.width, texture.height);
+		header.mipMapCount = (uint32_t)texture.levels;
+		header.reserved1[0] = TEXTURE_CACHE_MAGIC;
+		header.reserved1[1] = TEXTURE_CACHE_VERSION;
+		memcpy(&header.reserved1[2], &sourceHash, sizeof(sourceHash));
+		header.pixelFormat.size = sizeof(DDSPixelFormat);
+		header.pixelFormat.flags = DDPF_FOURCC;
+		header.pixelFormat.fourCC = texture.format == GL_COMPRESSED_SRGB_S3TC_DXT1_EXT ? DDS_FOURCC_DXT1 : DDS_FOURCC_DXT5;
+		header.caps = DDSCAPS_TEXTURE | DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+
+		// Written under a temporary name first, so an interrupted write never leaves a valid-looking file.
+		// The name is unique per write: two loader threads may compress the same source at once
+		static std::atomic<uint32_t> writeCount(0);
+		std::string tempFileName = fileName + "." + std::to_string(writeCount++) + ".tmp";
+		std::ofstream file(tempFileName.c_str(), std::ios::binary);
+		file.write((const char*)&DDS_MAGIC, sizeof(DDS_MAGIC));
+		file.write((const char*)&header, sizeof(header));
+		file.write((const char*)texture.data.data(), texture.data.size());
+		file.close();
+
+		if (!file) {
+			remove(tempFileName.c_str());
+			return false;
+		}
+
+		remove(fileName.c_str());
+		return rename(tempFileName.c_str(), fileName.c_str()) == 0;
+	}
+}
@@ -0,0 +1,36 @@
+#ifndef TextureCompressor_hpp
+#define TextureCompressor_hpp
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace gps {
+
+    // Block-compressed sRGB texture with its full mip chain; the levels are stored one after another,
+    // rows bottom-up as OpenGL expects them
+    struct CompressedTexture {
+        // GL_COMPRESSED_SRGB_S3TC_DXT1_EXT (BC1) or GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT (BC3)
+        GLenum format;
+        int width;
+        int height;
+        int levels;
+        std::vector<unsigned char> data;
+    };
+
+    // Size in bytes of one mip level of the given format
+    size_t compressedLevelSize(GLenum format, int width, int height);
+
+    // Builds the mip chain of RGBA8 sRGB pixels and encodes every level - as BC3 if
+    // any pixel is translucent, as BC1 otherwise
+    void compressTexture(const unsigned char* pixels, int width, int height, CompressedTexture* texture);
+
+    // Reads a .dds written by writeDDS; fails if it was made from a different source image
+    bool readDDS(std::string fileName, uint64_t sourceHash, CompressedTexture* texture);
+
+    bool writeDDS(std::string fileName, uint64_t sourceHash, const CompressedTexture& texture);
+}
+
+#endif /* TextureCompressor_hpp */
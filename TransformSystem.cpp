@@ -0,0 +1,150 @@
+#include "TransformSystem.hpp"
+#include "Simd.hpp"
+
+#include <glm/gtc/matrix_inverse.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace gps {
+
+	uint32_t TransformSystem::add(const glm::mat4& world) {
+		uint32_t index = (uint32_t)worlds.size();
+		worlds.push_back(world);
+
+		// Unbounded until setBounds(): an infinite radius passes every plane
+		gps::BoundingSphere unbounded;
+		unbounded.center = glm::vec3(0.0f);
+		unbounded.radius = std::numeric_limits<float>::infinity();
+		localSpheres.push_back(unbounded);
+
+		size_t padded = (worlds.size() + SIMD_LANES - 1) / SIMD_LANES * SIMD_LANES;
+		for (int e = 0; e < 9; e++) {
+			worldNormals[e].resize(padded, 0.0f);
+			viewNormals[e].resize(padded, 0.0f);
+		}
+		sphereX.resize(padded, 0.0f);
+		sphereY.resize(padded, 0.0f);
+		sphereZ.resize(padded, 0.0f);
+		sphereRadius.resize(padded, 0.0f);
+
+		setWorldNormal(index, world);
+		setWorldSphere(index);
+		return index;
+	}
+
+	void TransformSystem::setWorld(uint32_t index, const glm::mat4& world) {
+		worlds[index] = world;
+		setWorldNormal(index, world);
+		setWorldSphere(index);
+	}
+
+	void TransformSystem::setBounds(uint32_t index, const gps::BoundingSphere& sphere) {
+		localSpheres[index] = sphere;
+		setWorldSphere(index);
+	}
+
+	void TransformSystem::setWorldSphere(uint32_t index) {
+		const glm::mat4& world = worlds[index];
+		const gps::BoundingSphere& sphere = localSpheres[index];
+		glm::vec4 center = world * glm::vec4(sphere.center, 1.0f);
+
+		// Scaled by the longest axis, so the sphere still contains the object under non-uniform scale
+		float scaleSquared = std::max(glm::dot(glm::vec3(world[0]), glm::vec3(world[0])),
+			std::max(glm::dot(glm::vec3(world[1]), glm::vec3(world[1])), glm::dot(glm::vec3(world[2]), glm::vec3(world[2]))));
+
+		sphereX[index] = center.x;
+		sphereY[index] = center.y;
+		sphereZ[index] = center.z;
+		sphereRadius[index] = sphere.radius * std::sqrt(scaleSquared);
+	}
+
+	size_t TransformSystem::cull(const gps::Frustum& frustum, std::vector<uint8_t>& visible) const {
+		visible.resize(worlds.size());
+		if (worlds.empty()) {
+			return 0;
+		}
+		return frustum.cullSpheres(sphereX.data(), sphereY.data(), sphereZ.data(), sphereRadius.data(), worlds.size(), visible.data());
+	}
+
+	void TransformSystem::setWorldNormal(uint32_t index, const glm::mat4& world) {
+		glm::mat3 linear(world);
+		float length0 = glm::dot(linear[0], linear[0]);
+		float length1 = glm::dot(linear[1], linear[1]);
+		float length2 = glm::dot(linear[2], linear[2]);
+		float tolerance = 1e-5f * length0;
+
+		glm::mat3 normal;
+		if (length0 > 0.0f
+			&& std::fabs(length1 - length0) <= tolerance && std::fabs(length2 - length0) <= tolerance
+			&& std::fabs(glm::dot(linear[0], linear[1])) <= tolerance
+			&& std::fabs(glm::dot(linear[0], linear[2])) <= tolerance
+			&& std::fabs(glm::dot(linear[1], linear[2])) <= tolerance) {
+			// A rotation times a uniform scale s: the inverse transpose is the matrix over s^2
+			normal = linear * (1.0f / length0);
+		}
+		else {
+			normal = glm::inverseTranspose(linear);
+		}
+
+		for (int column = 0; column < 3; column++) {
+			for (int row = 0; row < 3; row++) {
+				worldNormals[column * 3 + row][index] = normal[column][row];
+			}
+		}
+	}
+
+	void TransformSystem::computeNormalMatrices(const glm::mat4& view) {
+		// inverseTranspose(A * B) = inverseTranspose(A) * inverseTranspose(B), so only the view
+		// is inverted here
+		glm::mat3 viewNormal = glm::inverseTranspose(glm::mat3(view));
+		size_t count = worldNormals[0].size();
+
+#ifdef GPS_SSE
+		__m128 v[9];
+		for (int column = 0; column < 3; column++) {
+			for (int row = 0; row < 3; row++) {
+				v[column * 3 + row] = _mm_set1_ps(viewNormal[column][row]);
+			}
+		}
+
+		for (size_t i = 0; i < count; i += SIMD_LANES) {
+			__m128 w[9];
+			for (int e = 0; e < 9; e++) {
+				w[e] = _mm_loadu_ps(&worldNormals[e][i]);
+			}
+
+			// (V * W)[column][row] = sum over k of V[k][row] * W[column][k]
+			for (int column = 0; column < 3; column++) {
+				for (int row = 0; row < 3; row++) {
+					__m128 sum = _mm_mul_ps(v[row], w[column * 3]);
+					sum = _mm_add_ps(sum, _mm_mul_ps(v[3 + row], w[column * 3 + 1]));
+					sum = _mm_add_ps(sum, _mm_mul_ps(v[6 + row], w[column * 3 + 2]));
+					_mm_storeu_ps(&viewNormals[column * 3 + row][i], sum);
+				}
+			}
+		}
+#else
+		for (size_t i = 0; i < count; i++) {
+			for (int column = 0; column < 3; column++) {
+				for (int row = 0; row < 3; row++) {
+					viewNormals[column * 3 + row][i] = viewNormal[0][row] * worldNormals[column * 3][i]
+						+ viewNormal[1][row] * worldNormals[column * 3 + 1][i]
+						+ viewNormal[2][row] * worldNormals[column * 3 + 2][i];
+				}
+			}
+		}
+#endif
+	}
+
+	glm::mat3 TransformSystem::getNormalMatrix(uint32_t index) const {
+		glm::mat3 normal;
+		for (int column = 0; column < 3; column++) {
+			for (int row = 0; row < 3; row++) {
+				normal[column][row] = viewNormals[column * 3 + row][index];
+			}
+		}
+		return normal;
+	}
+}
@@ -0,0 +1,60 @@
+#ifndef TransformSystem_hpp
+#define TransformSystem_hpp
+
+#include "Frustum.hpp"
+#include "Mesh.hpp"
+
+#include "glm/glm.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace gps {
+
+    // World matrices of the scene objects, their normal matrices for the current view and
+    // their world-space bounding spheres. The inverse transpose of each world matrix's upper 3x3
+    // and the world sphere are computed once, when the matrix is set, and kept in
+    // structure-of-arrays form (one array per element). That way the per-view steps, a 3x3
+    // product and a frustum test, run on four objects at a time with SSE
+    class TransformSystem
+    {
+    public:
+        // Adds an object and returns its index
+        uint32_t add(const glm::mat4& world);
+        // Changes an object's world matrix; static objects only pay for this once, in add()
+        void setWorld(uint32_t index, const glm::mat4& world);
+        const glm::mat4& getWorld(uint32_t index) const { return worlds[index]; }
+
+        // Model-space bounds of an object; objects without bounds are never culled
+        void setBounds(uint32_t index, const gps::BoundingSphere& sphere);
+
+        // Sets visible[i] to 1 for the objects whose bounds intersect the frustum and to 0 for
+        // the others; returns how many are visible
+        size_t cull(const gps::Frustum& frustum, std::vector<uint8_t>& visible) const;
+
+        // Computes inverseTranspose(mat3(view * world)) for every object in one batch
+        void computeNormalMatrices(const glm::mat4& view);
+        // Normal matrix from the last computeNormalMatrices() call
+        glm::mat3 getNormalMatrix(uint32_t index) const;
+
+        size_t size() const { return worlds.size(); }
+
+    private:
+        std::vector<glm::mat4> worlds;
+        // Element [column * 3 + row] of every object's normal matrix, padded to a multiple of 4
+        std::vector<float> worldNormals[9];
+        std::vector<float> viewNormals[9];
+        std::vector<gps::BoundingSphere> localSpheres;
+        // Center x, y, z and radius of every object's world sphere, padded like the normals
+        std::vector<float> sphereX;
+        std::vector<float> sphereY;
+        std::vector<float> sphereZ;
+        std::vector<float> sphereRadius;
+
+        void setWorldNormal(uint32_t index, const glm::mat4& world);
+        void setWorldSphere(uint32_t index);
+    };
+}
+
+#endif /* TransformSystem_hpp */
@@ -8,12 +8,27 @@
 #include <glm/gtc/type_ptr.hpp> //glm extension for accessing the internal data structure of glm types
 
 #include "Window.h"
+#include "AllocationCounter.hpp"
+#include "Bvh.hpp"
+#include "CascadedShadowMap.hpp"
+#include "ClusteredLights.hpp"
+#include "GBuffer.hpp"
+#include "GpuTimer.hpp"
 #include "Shader.hpp"
 #include "Camera.hpp"
 #include "Model3D.hpp"
+#include "ModelLoader.hpp"
+#include "PointShadowMap.hpp"
+#include "RenderQueue.hpp"
+#include "Scene.hpp"
+#include "TransformSystem.hpp"
 #include "SkyBox.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
 #include <iostream>
+#include <random>
 
 // window
 gps::Window myWindow;
@@ -30,66 +45,54 @@ glm::mat4 lightRotation;
 glm::vec3 lightDir;
 glm::vec3 lightColor;
 
-// shader uniform locations
-GLuint modelLoc;
-GLuint viewLoc;
-GLuint projectionLoc;
-GLuint normalMatrixLoc;
-GLuint lightDirLoc;
-GLuint lightColorLoc;
-
-glm::vec4 pointSource;
-GLuint pointSourceLoc;
-glm::vec3 pointColor;
-GLuint pointColorLoc;
-
-glm::vec4 wolfSource;
-GLuint wolfSourceLoc;
-glm::vec3 wolfColor;
-GLuint wolfColorLoc;
-
 
 gps::Camera myCamera(
     glm::vec3(0.0f, 0.0f, 3.0f),
     glm::vec3(0.0f, 0.0f, -10.0f),
     glm::vec3(0.0f, 1.0f, 0.0f));
 
+// change per update tick: the tour in presentScene moves at cameraSpeed; the keys keep the speed they had
+// when processMovement ran twice per frame
 GLfloat cameraSpeed = 0.02f;
+GLfloat manualCameraSpeed = 0.04f;
+const GLfloat LIGHT_ROTATION_STEP = 2.0f;
+const GLfloat TREE_SCALE_STEP = 0.02f;
 
 GLboolean pressedKeys[1024];
 
-gps::Model3D ground;
-gps::Model3D structures;
-gps::Model3D campsite;
-
-gps::Model3D bow;
-gps::Model3D arrow;
-
-gps::Model3D trees;
-gps::Model3D scalableTrees;
-
-gps::Model3D boat;
-gps::Model3D bucketWater;
+// models, animation channels and entities from the scene file
+const char* const SCENE_FILE = "scenes/main.scene";
+gps::Scene scene;
+int treesChannel = -1;
+int ducksChannel = -1;
 
-gps::Model3D cat;
-gps::Model3D horse;
-gps::Model3D wolf;
-
-gps::Model3D ducks;
-gps::Model3D rotatedDuck;
-gps::Model3D staticDucks;
-
-gps::Model3D plane;
-
-gps::Model3D lantern;
 gps::Model3D screenQuad;
-
 gps::Model3D lightCube;
 
+// reads the models in the background; declared after them (and the scene) so its workers stop before the models are destroyed
+gps::ModelLoader modelLoader;
+// time spent on texture/mesh uploads each frame while models are still loading
+const double UPLOAD_BUDGET_MS = 4.0;
+bool modelsLoaded = false;
+// once the models are loaded, heap allocations and culled entities are reported over windows of this many frames;
+// a steady-state frame should make no allocations. The first window also reports the GL state calls issued and skipped
+const size_t ALLOCATION_REPORT_FRAMES = 600;
+// movement and animations advance in fixed ticks of this many seconds, independent of the frame rate;
+// after a long stall at most MAX_UPDATES_PER_FRAME ticks are run and the rest of the time is dropped
+const double UPDATE_STEP = 1.0 / 60.0;
+const int MAX_UPDATES_PER_FRAME = 8;
+// entities left after frustum culling in the last frame, per pass, averaged over each report window
+size_t visibleEntities[gps::PASS_COUNT] = {0, 0};
+// static shadow layers redrawn in the last frame, out of one per cascade
+size_t staticCascadesDrawn = 0;
+
 GLfloat angle = 0;
 
 gps::Shader myBasicShader;
+gps::Shader deferredShader;
 gps::Shader depthMapShader;
+gps::Shader gBufferShader;
+gps::Shader pointShadowShader;
 gps::Shader lightCubeShader;
 gps::Shader screenQuadShader;
 gps::Shader shaderStart;
@@ -98,11 +101,30 @@ gps::Shader skyBoxShader;
 gps::SkyBox mySkyBox;
 std::vector<const GLchar*> faces;
 
-GLuint shadowMapFBO;
-GLuint depthMapTexture;
-
-const GLuint SHADOW_WIDTH = 1024;
-const GLuint SHADOW_HEIGHT = 1024;
+// cascade count, layer resolution, shadow distance, split lambda, static caster caching, filter,
+// Poisson radius and bias; count, resolution, caching and filter can be set on the command
+// line (see main), and F cycles through the filters
+gps::ShadowSettings shadowSettings = {3, 1024, 20.0f, 0.75f, true, gps::FILTER_PCF, 2.0f, 1.0f, 1.0f};
+gps::CascadedShadowMap shadowMap;
+// cube count, cube resolution and cubes redrawn per frame; the last two can be set on the command line
+gps::PointShadowSettings pointShadowSettings = {gps::MAX_POINT_SHADOWS, 512, 2};
+gps::PointShadowMap pointShadows;
+// the scene's point lights, plus --extra-lights random ones (see main)
+gps::ClusteredLights clusteredLights;
+int extraLights = 0;
+// forward or deferred shading; G switches between them and --deferred starts with deferred
+gps::RENDER_PATH renderPath = gps::PATH_FORWARD;
+gps::GBuffer gBuffer;
+// GPU time of the opaque surfaces and their lighting, which samples the shadow map, for each
+// path and filter
+gps::GpuTimer shadingTimers[gps::RENDER_PATH_COUNT][gps::FILTER_COUNT];
+
+const GLfloat CAMERA_FAR_PLANE = 1000.0f;
+const GLfloat CAMERA_NEAR_PLANE = 0.1f;
+const GLfloat CAMERA_FOV = glm::radians(45.0f);
+
+// draws of the current frame, sorted to minimize state changes
+gps::RenderQueue renderQueue;
 
 float pitch = 0;
 float yaw = -90;
@@ -115,25 +137,8 @@ double yposs = 0;
 double lastX = 400;
 double lastY = 300;
 
-bool depth = true;
 bool showDepthMap = false;
 
-float moveBoat = 0.0f;
-int rotateBoat = 0;
-
-bool toScaleTrees = false;
-float scaleTrees = 0.0f;
-
-bool shootArrow = false;
-bool shot = false;
-bool arrowDistance = 0.0f;
-
-bool toMoveDucks = false;
-float moveDucks = 0.0f;
-
-bool toMovePlane = false;
-bool movePlane = 0.0f;
-
 bool beginPresentation = false;
 int goFront = 1;
 int goRight = 0;
@@ -187,9 +192,8 @@ void windowResizeCallback(GLFWwindow* window, int width, int height) {
     myWindow.setWindowDimensions(dimensions);
     shaderStart.useShaderProgram();
     
-    projection = glm::perspective(glm::radians(45.0f), (float)myWindow.getWindowDimensions().width / (float)myWindow.getWindowDimensions().height, 0.1f, 1000.0f);
-    projectionLoc = glGetUniformLocation(shaderStart.shaderProgram, "projection");
-    glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
+    projection = glm::perspective(CAMERA_FOV, (float)myWindow.getWindowDimensions().width / (float)myWindow.getWindowDimensions().height, CAMERA_NEAR_PLANE, CAMERA_FAR_PLANE);
+    shaderStart.setMat4("projection", projection);
 }
 
 void keyboardCallback(GLFWwindow* window, int key, int scancode, int action, int mode) {
@@ -197,6 +201,17 @@ void keyboardCallback(GLFWwindow* window, int key, int scancode, int action, int
         glfwSetWindowShouldClose(window, GL_TRUE);
     }
 
+    if (key == GLFW_KEY_F && action == GLFW_PRESS) {
+        gps::SHADOW_FILTER filter = (gps::SHADOW_FILTER)((shadowMap.getSettings().filter + 1) % gps::FILTER_COUNT);
+        shadowMap.setFilter(filter);
+        printf("Shadow filter    : %s\n", gps::getShadowFilterName(filter));
+    }
+
+    if (key == GLFW_KEY_G && action == GLFW_PRESS) {
+        renderPath = (gps::RENDER_PATH)((renderPath + 1) % gps::RENDER_PATH_COUNT);
+        printf("Shading          : %s\n", gps::getRenderPathName(renderPath));
+    }
+
 	if (key >= 0 && key < 1024) {
         if (action == GLFW_PRESS) {
             pressedKeys[key] = true;
@@ -239,31 +254,31 @@ void mouseCallback(GLFWwindow* window, double xpos, double ypos) {
 
 void processMovement() {
     if (pressedKeys[GLFW_KEY_W]) {
-        myCamera.move(gps::MOVE_FORWARD, cameraSpeed);
+        myCamera.move(gps::MOVE_FORWARD, manualCameraSpeed);
     }
 
     if (pressedKeys[GLFW_KEY_S]) {
-        myCamera.move(gps::MOVE_BACKWARD, cameraSpeed);
+        myCamera.move(gps::MOVE_BACKWARD, manualCameraSpeed);
     }
 
     if (pressedKeys[GLFW_KEY_A]) {
-        myCamera.move(gps::MOVE_LEFT, cameraSpeed);
+        myCamera.move(gps::MOVE_LEFT, manualCameraSpeed);
     }
 
     if (pressedKeys[GLFW_KEY_D]) {
-        myCamera.move(gps::MOVE_RIGHT, cameraSpeed);
+        myCamera.move(gps::MOVE_RIGHT, manualCameraSpeed);
     }
 
     if (pressedKeys[GLFW_KEY_UP]) {
-        myCamera.move(gps::MOVE_UP, cameraSpeed);
+        myCamera.move(gps::MOVE_UP, manualCameraSpeed);
     }
 
     if (pressedKeys[GLFW_KEY_DOWN]) {
-        myCamera.move(gps::MOVE_DOWN, cameraSpeed);
+        myCamera.move(gps::MOVE_DOWN, manualCameraSpeed);
     }
 
     if (pressedKeys[GLFW_KEY_J]) {
-        angle += 1.0f;
+        angle += LIGHT_ROTATION_STEP;
         if (angle > 360.0f)
             angle -= 360.0f;
         glm::vec3 lightDirTr = glm::vec3(glm::rotate(glm::mat4(1.0f), glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f)) * glm::vec4(lightDir, 1.0f));
@@ -271,7 +286,7 @@ void processMovement() {
     }
 
     if (pressedKeys[GLFW_KEY_K]) {
-        angle -= 1.0f;
+        angle -= LIGHT_ROTATION_STEP;
         if (angle < 0.0f)
             angle += 360.0f;
         glm::vec3 lightDirTr = glm::vec3(glm::rotate(glm::mat4(1.0f), glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f)) * glm::vec4(lightDir, 1.0f));
@@ -300,26 +315,15 @@ void processMovement() {
     }
 
     if (pressedKeys[GLFW_KEY_C]) {
-        toScaleTrees = true;
-        scaleTrees += 0.01f;
+        scene.setChannelValue(treesChannel, scene.getChannelValue(treesChannel) + TREE_SCALE_STEP);
     }
 
     if (pressedKeys[GLFW_KEY_V]) {
-        toScaleTrees = true;
-        scaleTrees -= 0.01f;
-    }
-
-    if (pressedKeys[GLFW_KEY_B]) {
-        shootArrow = true;
-    }
-
-    if (pressedKeys[GLFW_KEY_N]) {
-        shootArrow = false;
-        arrowDistance = 0.0f;
+        scene.setChannelValue(treesChannel, scene.getChannelValue(treesChannel) - TREE_SCALE_STEP);
     }
 
     if (pressedKeys[GLFW_KEY_T]) {
-        toMoveDucks = true;
+        scene.triggerChannel(ducksChannel);
     }
 
 
@@ -387,61 +391,70 @@ void setWindowCallbacks() {
 
 void initOpenGLState() {
 	glClearColor(0.7f, 0.7f, 0.7f, 1.0f);
-	glViewport(0, 0, myWindow.getWindowDimensions().width, myWindow.getWindowDimensions().height);
+	gps::GLState::getInstance().viewport(0, 0, myWindow.getWindowDimensions().width, myWindow.getWindowDimensions().height);
     glEnable(GL_FRAMEBUFFER_SRGB);
 	glEnable(GL_DEPTH_TEST); // enable depth-testing
-	glDepthFunc(GL_LESS); // depth-testing interprets a smaller value as "closer"
+	gps::GLState::getInstance().depthFunc(GL_LESS); // depth-testing interprets a smaller value as "closer"
 	glEnable(GL_CULL_FACE); // cull face
 	glCullFace(GL_BACK); // cull back face
 	glFrontFace(GL_CCW); // GL_CCW for counter clock-wise
 }
 
 void initFBOs() {
-    glGenFramebuffers(1, &shadowMapFBO);
-    glGenTextures(1, &depthMapTexture);
-    glBindTexture(GL_TEXTURE_2D, depthMapTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-    glBindFramebuffer(GL_FRAMEBUFFER, shadowMapFBO);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthMapTexture, 0);
-    glDrawBuffer(GL_NONE);
-    glReadBuffer(GL_NONE);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    shadowMap.init(shadowSettings);
+    pointShadows.init(pointShadowSettings);
+    clusteredLights.init();
+    gBuffer.init(myWindow.getWindowDimensions().width, myWindow.getWindowDimensions().height);
+    for (int path = 0; path < gps::RENDER_PATH_COUNT; path++) {
+        for (int filter = 0; filter < gps::FILTER_COUNT; filter++) {
+            shadingTimers[path][filter].init();
+        }
+    }
 }
 
-void initModels() {
-
-    //environment
-    ground.LoadModel("models/ground/ground4.obj");
-    structures.LoadModel("models/buildings/structures.obj");
-    campsite.LoadModel("models/buildings/campsite.obj");
-    trees.LoadModel("models/trees/staticTrees.obj");
-    cat.LoadModel("models/cat/cats.obj");
-    horse.LoadModel("models/horse/horse.obj");
-    bow.LoadModel("models/bow and arrow/bow.obj");
-    staticDucks.LoadModel("models/duck/staticDucks.obj");
-    rotatedDuck.LoadModel("models/duck/rotateDuck.obj");
-
-    //moving
-    boat.LoadModel("models/boat/boat.obj");
-    ducks.LoadModel("models/duck/movingDucks.obj");
-    arrow.LoadModel("models/bow and arrow/arrow.obj");
-    scalableTrees.LoadModel("models/trees/scalableTrees.obj");
-    bucketWater.LoadModel("models/ground/bucketWater.obj");
-    plane.LoadModel("models/plane/plane.obj");
-    
-    //lighting 
-    lantern.LoadModel("models/lantern/lantern.obj");
-    lightCube.LoadModel("models/cube/cube.obj");
-    screenQuad.LoadModel("models/quad/quad.obj");
-    wolf.LoadModel("models/cat/wolf.obj");
-
-   
-   
+// The scene's lights, the first ones asking for shadows getting the cubes, then the extra lights:
+// small, unshadowed and scattered over the scene with a fixed seed, so runs are comparable
+void initLights() {
+    const std::vector<gps::SceneLight>& sceneLights = scene.getLights();
+    for (size_t i = 0; i < sceneLights.size(); i++) {
+        gps::PointLight light;
+        light.position = sceneLights[i].position;
+        light.radius = sceneLights[i].radius;
+        light.color = sceneLights[i].color;
+        light.shadow = sceneLights[i].castsShadows ? pointShadows.addLight(light.position, light.radius) : -1;
+        clusteredLights.addLight(light);
+    }
+
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> across(-10.0f, 10.0f);
+    std::uniform_real_distribution<float> height(0.0f, 2.0f);
+    std::uniform_real_distribution<float> channel(0.2f, 1.0f);
+    for (int i = 0; i < extraLights; i++) {
+        gps::PointLight light;
+        light.position = glm::vec3(across(random), height(random), across(random));
+        light.radius = 1.5f;
+        light.color = glm::vec3(channel(random), channel(random), channel(random));
+        light.shadow = -1;
+        clusteredLights.addLight(light);
+    }
+    printf("Point lights   : %zu, %d with shadows\n", clusteredLights.getLightCount(), pointShadows.getLightCount());
+}
+
+// Returns false if the scene file cannot be loaded
+bool initModels() {
+    // models show up as they finish loading; the main loop does the uploads
+    modelLoader.start();
+
+    if (!scene.load(SCENE_FILE, modelLoader)) {
+        return false;
+    }
+    treesChannel = scene.findChannel("trees");
+    ducksChannel = scene.findChannel("ducks");
+    initLights();
+
+    modelLoader.loadModel(&lightCube, "models/cube/cube.obj");
+    modelLoader.loadModel(&screenQuad, "models/quad/quad.obj");
+    return true;
 }
 
 void initSkyBox() {
@@ -454,7 +467,10 @@ void initSkyBox() {
 }
 
 void initShaders() {
+    deferredShader.loadShader("shaders/screenQuadShader.vert", "shaders/deferredShader.frag");
     depthMapShader.loadShader("shaders/depthMapShader.vert", "shaders/depthMapShader.frag");
+    gBufferShader.loadShader("shaders/shaderStart.vert", "shaders/gBufferShader.frag");
+    pointShadowShader.loadShader("shaders/pointShadowShader.vert", "shaders/pointShadowShader.geom", "shaders/pointShadowShader.frag");
     lightCubeShader.loadShader("shaders/lightCubeShader.vert", "shaders/lightCubeShader.frag");
     screenQuadShader.loadShader("shaders/screenQuadShader.vert", "shaders/screenQuadShader.frag");
     shaderStart.loadShader("shaders/shaderStart.vert", "shaders/shaderStart.frag");
@@ -465,41 +481,26 @@ void initUniforms() {
 	shaderStart.useShaderProgram();
 
     model = glm::rotate(glm::mat4(1.0f), glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f));
-	modelLoc = glGetUniformLocation(shaderStart.shaderProgram, "model");
 
 	view = myCamera.getViewMatrix();
-	viewLoc = glGetUniformLocation(shaderStart.shaderProgram, "view");
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
+    shaderStart.setMat4("view", view);
 
     normalMatrix = glm::mat3(glm::inverseTranspose(view*model));
-	normalMatrixLoc = glGetUniformLocation(shaderStart.shaderProgram, "normalMatrix");
-    glUniformMatrix3fv(normalMatrixLoc, 1, GL_FALSE, glm::value_ptr(normalMatrix));
+    shaderStart.setMat3("normalMatrix", normalMatrix);
 
-	projection = glm::perspective(glm::radians(45.0f), (float)myWindow.getWindowDimensions().width / (float)myWindow.getWindowDimensions().height, 0.1f, 1000.0f);
-	projectionLoc = glGetUniformLocation(shaderStart.shaderProgram, "projection");
-	glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));	
+	projection = glm::perspective(CAMERA_FOV, (float)myWindow.getWindowDimensions().width / (float)myWindow.getWindowDimensions().height, CAMERA_NEAR_PLANE, CAMERA_FAR_PLANE);
+	shaderStart.setMat4("projection", projection);	
 
 	lightDir = glm::vec3(0.0f, 1.0f, 3.0f);
     lightRotation = glm::rotate(glm::mat4(1.0f), glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f));
-	lightDirLoc = glGetUniformLocation(shaderStart.shaderProgram, "lightDir");
-    glUniform3fv(lightDirLoc, 1, glm::value_ptr(glm::inverseTranspose(glm::mat3(view * lightRotation)) * lightDir));
+    shaderStart.setVec3("lightDir", glm::inverseTranspose(glm::mat3(view * lightRotation)) * lightDir);
 
 	lightColor = glm::vec3(1.0f, 1.0f, 1.0f); 
-	lightColorLoc = glGetUniformLocation(shaderStart.shaderProgram, "lightColor");
-	glUniform3fv(lightColorLoc, 1, glm::value_ptr(lightColor));
-
-    pointColor = glm::vec3(0.0f, 0.0f, 1.0f);
-    pointColorLoc = glGetUniformLocation(shaderStart.shaderProgram, "pointLightColor");
-    glUniform3fv(pointColorLoc, 1, glm::value_ptr(pointColor));
-    pointSourceLoc = glGetUniformLocation(shaderStart.shaderProgram, "pointLightSource");
-
-    wolfColor = glm::vec3(1.0f, 0.0f, 1.0f);
-    wolfColorLoc = glGetUniformLocation(shaderStart.shaderProgram, "wolfLightColor");
-    glUniform3fv(wolfColorLoc, 1, glm::value_ptr(wolfColor));
-    wolfSourceLoc = glGetUniformLocation(shaderStart.shaderProgram, "wolfLightSource");
+	shaderStart.setVec3("lightColor", lightColor);
+    deferredShader.setVec3("lightColor", lightColor);
 
     lightCubeShader.useShaderProgram();
-    glUniformMatrix4fv(glGetUniformLocation(lightCubeShader.shaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+    lightCubeShader.setMat4("projection", projection);
 
     
     mySkyBox.Load(faces);
@@ -508,373 +509,584 @@ void initUniforms() {
 
 }
 
-void computePointLight() {
-    pointSource = glm::translate(glm::mat4(1.0f), glm::vec3(2.8f, 0.5f, 0.6f)) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
-    glUniform3fv(pointSourceLoc, 1, glm::value_ptr(view * pointSource));
-    glUniformMatrix3fv(normalMatrixLoc, 1, GL_FALSE, glm::value_ptr(normalMatrix));
+// Draws the shadow casters into every cascade of the shadow map
+void renderShadowMap() {
+    float aspect = (float)myWindow.getWindowDimensions().width / (float)myWindow.getWindowDimensions().height;
+    shadowMap.update(view, CAMERA_FOV, aspect, CAMERA_NEAR_PLANE, glm::mat3(lightRotation) * lightDir);
+
+    depthMapShader.useShaderProgram();
+    visibleEntities[gps::PASS_SHADOW] = 0;
+    staticCascadesDrawn = 0;
+    // Without caching every caster is drawn into the cascade itself
+    gps::ENTITY_SET cascadeCasters = shadowMap.getSettings().cacheStatic ? gps::ENTITIES_DYNAMIC : gps::ENTITIES_ALL;
+
+    // Casters between the light and a cascade's near plane still shade it: the near plane is
+    // not culled against, and depth clamping flattens them onto it instead of clipping them
+    glEnable(GL_DEPTH_CLAMP);
+    for (int cascade = 0; cascade < shadowMap.getSettings().cascadeCount; cascade++) {
+        const glm::mat4& lightSpaceTrMatrix = shadowMap.getLightSpaceMatrix(cascade);
+        depthMapShader.setMat4("lightSpaceTrMatrix", lightSpaceTrMatrix);
+        renderQueue.setPassView(gps::PASS_SHADOW, shadowMap.getCascadeView(cascade), shadowMap.getCascadeDepth(cascade));
+
+        gps::Frustum lightFrustum(lightSpaceTrMatrix);
+        lightFrustum.ignorePlane(gps::PLANE_NEAR);
+
+        if (shadowMap.beginStaticCascade(cascade, scene.getStaticRevision())) {
+            visibleEntities[gps::PASS_SHADOW] += scene.cull(gps::PASS_SHADOW, lightFrustum, gps::ENTITIES_STATIC);
+            scene.submit(renderQueue, gps::PASS_SHADOW, depthMapShader);
+            renderQueue.draw(gps::PASS_SHADOW);
+            staticCascadesDrawn++;
+        }
+
+        shadowMap.beginCascade(cascade);
+        visibleEntities[gps::PASS_SHADOW] += scene.cull(gps::PASS_SHADOW, lightFrustum, cascadeCasters);
+        scene.submit(renderQueue, gps::PASS_SHADOW, depthMapShader);
+        renderQueue.draw(gps::PASS_SHADOW);
+    }
+    glDisable(GL_DEPTH_CLAMP);
+
+    gps::GLState::getInstance().bindFramebuffer(0);
 }
 
-void computeWolfLight() {
-    wolfSource = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 2.0f, -5.0f)) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
-    glUniform3fv(wolfSourceLoc, 1, glm::value_ptr(view * wolfSource));
-    glUniformMatrix3fv(normalMatrixLoc, 1, GL_FALSE, glm::value_ptr(normalMatrix));
+// Redraws the point light cubes that are out of date, within the per-frame budget
+void renderPointShadows() {
+    pointShadows.beginFrame(scene.getStaticRevision());
+    // Casters that moved in range, or out of it, since the last frame change the shadow
+    for (int light = 0; light < pointShadows.getLightCount(); light++) {
+        if (scene.countMovedCasters(pointShadows.getLightRange(light)) > 0) {
+            pointShadows.markDirty(light);
+        }
+    }
+
+    pointShadowShader.useShaderProgram();
+    int light;
+    while ((light = pointShadows.nextUpdate()) >= 0) {
+        pointShadows.beginLight(light, pointShadowShader);
+        scene.cull(gps::PASS_SHADOW, pointShadows.getLightRange(light));
+        renderQueue.setPassView(gps::PASS_SHADOW, glm::translate(glm::mat4(1.0f), -pointShadows.getLightPosition(light)),
+            pointShadows.getLightRadius(light));
+        scene.submit(renderQueue, gps::PASS_SHADOW, pointShadowShader);
+        renderQueue.draw(gps::PASS_SHADOW);
+    }
+
+    gps::GLState::getInstance().bindFramebuffer(0);
 }
 
-glm::mat4 computeLightSpaceTrMatrix() {
-    const GLfloat near_plane = 0.1f;
-    const GLfloat far_plane = 50.0f;
+// The lights and shadows both paths shade with; their textures take the units after the meshes'
+void setLightingUniforms(gps::Shader& shader) {
+    shader.setVec3("lightDir", glm::inverseTranspose(glm::mat3(view * lightRotation)) * lightDir);
 
-    glm::mat4 lightProjection = glm::ortho(-7.0f, 7.0f, -7.0f, 7.0f, near_plane, far_plane);
-    glm::vec3 lightDirTr = glm::vec3(glm::rotate(glm::mat4(1.0f), glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f)) * glm::vec4(lightDir, 1.0f));
-    glm::mat4 lightView = glm::lookAt(glm::mat3(lightRotation) * lightDir, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-    //glm::mat4 lightView = glm::lookAt(lightDirTr, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-    return lightProjection * lightView;
+    shadowMap.setUniforms(shader, gps::MESH_TEXTURE_UNITS);
+    // The cascades take two units
+    pointShadows.setUniforms(shader, gps::MESH_TEXTURE_UNITS + 2);
+    clusteredLights.setUniforms(shader, gps::MESH_TEXTURE_UNITS + 3);
+}
+
+// Draws the culled opaque entities into the G-buffer, then lights each covered pixel of the
+// window once. The lighting pass writes the G-buffer depth, so the light cube and the sky box
+// drawn after it are still hidden behind the scene
+void renderDeferred() {
+    gps::GLState& state = gps::GLState::getInstance();
+    WindowDimensions dimensions = myWindow.getWindowDimensions();
+    gBuffer.resize(dimensions.width, dimensions.height);
+    gBuffer.begin();
+
+    gBufferShader.setMat4("view", view);
+    gBufferShader.setMat4("projection", projection);
+    scene.submit(renderQueue, gps::PASS_OPAQUE, gBufferShader);
+    renderQueue.draw(gps::PASS_OPAQUE);
+
+    state.bindFramebuffer(0);
+    state.viewport(0, 0, dimensions.width, dimensions.height);
+    deferredShader.useShaderProgram();
+    setLightingUniforms(deferredShader);
+    // The point lights take three units
+    gBuffer.setUniforms(deferredShader, gps::MESH_TEXTURE_UNITS + 6);
+    deferredShader.setMat4("inverseProjection", glm::inverse(projection));
+    deferredShader.setMat4("inverseView", glm::inverse(view));
+
+    state.depthFunc(GL_ALWAYS);
+    screenQuad.Draw(deferredShader);
+    state.depthFunc(GL_LESS);
 }
 
 void renderSkyBox() {
     skyBoxShader.useShaderProgram();
-    view = myCamera.getViewMatrix();
-    glUniformMatrix4fv(glGetUniformLocation(skyBoxShader.shaderProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
-    projection = glm::perspective(glm::radians(45.0f), (float)myWindow.getWindowDimensions().width / (float)myWindow.getWindowDimensions().height, 0.1f, 1000.0f);
-    glUniformMatrix4fv(glGetUniformLocation(skyBoxShader.shaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+    skyBoxShader.setMat4("view", view);
+    projection = glm::perspective(CAMERA_FOV, (float)myWindow.getWindowDimensions().width / (float)myWindow.getWindowDimensions().height, CAMERA_NEAR_PLANE, CAMERA_FAR_PLANE);
+    skyBoxShader.setMat4("projection", projection);
     mySkyBox.Draw(skyBoxShader, view, projection);
 }
 
 
 void renderLightCube() {
     lightCubeShader.useShaderProgram();
-    glUniformMatrix4fv(glGetUniformLocation(lightCubeShader.shaderProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
+    lightCubeShader.setMat4("view", view);
     model = glm::rotate(glm::mat4(1.0f), glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f));
     model = glm::translate(model, 1.0f * lightDir);
     model = glm::scale(model, glm::vec3(0.05f, 0.05f, 0.05f));
-    glUniformMatrix4fv(glGetUniformLocation(lightCubeShader.shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
+    lightCubeShader.setMat4("model", model);
     lightCube.Draw(lightCubeShader);
 
 }
 
-void renderGround(gps::Shader shader) {
-    model = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -0.5f, 0.0f));
-    glUniformMatrix4fv(glGetUniformLocation(shader.shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-    if (depth == false) {
-        normalMatrix = glm::mat3(glm::inverseTranspose(view * model));
-        glUniformMatrix3fv(glGetUniformLocation(shader.shaderProgram, "normalMatrix"), 1, GL_FALSE, glm::value_ptr(normalMatrix));
-    }
-    ground.Draw(shader);
+// One simulation tick: input, the camera tour and the scene animations
+void updateSimulation() {
+    myCamera.savePosition();
+    processMovement();
+    presentScene();
+    scene.update();
 }
 
-void renderTrees(gps::Shader shader) {
-    model = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -0.5f, 0.0f));
-    glUniformMatrix4fv(glGetUniformLocation(shader.shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-    if (depth == false) {
-        normalMatrix = glm::mat3(glm::inverseTranspose(view * model));
-        glUniformMatrix3fv(glGetUniformLocation(shader.shaderProgram, "normalMatrix"), 1, GL_FALSE, glm::value_ptr(normalMatrix));
-    }
-    trees.Draw(shader);
-}
+// Draws the frame from the state blended between the last two ticks; the passes only read
+// the matrices computed here
+void renderScene(float alpha) {
 
-void renderScalableTrees(gps::Shader shader) {
+    scene.interpolate(alpha);
+    view = myCamera.getViewMatrix(alpha);
 
-    model = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -0.6f, 0.0f));
-    if (toScaleTrees == true) {
-        model = glm::scale(model, glm::vec3(1.0f + scaleTrees, 1.0f + scaleTrees, 1.0f + scaleTrees));
-    }
+    lightRotation = glm::rotate(glm::mat4(1.0f), glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f));
 
-    glUniformMatrix4fv(glGetUniformLocation(shader.shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-    if (depth == false) {
-        normalMatrix = glm::mat3(glm::inverseTranspose(view * model));
-        glUniformMatrix3fv(glGetUniformLocation(shader.shaderProgram, "normalMatrix"), 1, GL_FALSE, glm::value_ptr(normalMatrix));
-    }
-    scalableTrees.Draw(shader);
-}
+    renderQueue.clear();
+    renderShadowMap();
+    renderPointShadows();
+    gps::GLState& state = gps::GLState::getInstance();
 
 
-void renderStructures(gps::Shader shader) {
-    model = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -0.5f, 0.0f));
-    glUniformMatrix4fv(glGetUniformLocation(shader.shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-    if (depth == false) {
-        normalMatrix = glm::mat3(glm::inverseTranspose(view * model));
-        glUniformMatrix3fv(glGetUniformLocation(shader.shaderProgram, "normalMatrix"), 1, GL_FALSE, glm::value_ptr(normalMatrix));
-    }
-    structures.Draw(shader);
-}
+    if (showDepthMap) {
+        state.viewport(0, 0, myWindow.getWindowDimensions().width, myWindow.getWindowDimensions().height);
+        glClear(GL_COLOR_BUFFER_BIT);
+        screenQuadShader.useShaderProgram();
 
-void renderCampsite(gps::Shader shader) {
-    model = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -0.5f, 0.0f));
-    glUniformMatrix4fv(glGetUniformLocation(shader.shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-    if (depth == false) {
-        normalMatrix = glm::mat3(glm::inverseTranspose(view * model));
-        glUniformMatrix3fv(glGetUniformLocation(shader.shaderProgram, "normalMatrix"), 1, GL_FALSE, glm::value_ptr(normalMatrix));
-    }
-    campsite.Draw(shader);
-}
+        // Units below MESH_TEXTURE_UNITS belong to the meshes' own textures; the nearest cascade is
+        // shown, read through the unit without depth comparison
+        shadowMap.bindTextures(gps::MESH_TEXTURE_UNITS);
+        screenQuadShader.setInt("depthMap", gps::MESH_TEXTURE_UNITS + 1);
+        screenQuadShader.setInt("depthMapLayer", 0);
 
-void renderCat(gps::Shader shader) {
-    model = glm::rotate(glm::mat4(1.0f), glm::radians(-10.0f), glm::vec3(-0.2f, 1.2f, 1.0f));
-    model = glm::translate(model, glm::vec3(-1.3f, -0.3f, 0.0f));
-    model = glm::scale(model, glm::vec3(1.5f, 1.5f, 1.5f));
-    glUniformMatrix4fv(glGetUniformLocation(shader.shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-    if (depth == false) {
-        normalMatrix = glm::mat3(glm::inverseTranspose(view * model));
-        glUniformMatrix3fv(glGetUniformLocation(shader.shaderProgram, "normalMatrix"), 1, GL_FALSE, glm::value_ptr(normalMatrix));
-    }
-    cat.Draw(shader);
-}
-
-void renderHorse(gps::Shader shader) {
-    model = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -0.5f, 0.0f));
-    glUniformMatrix4fv(glGetUniformLocation(shader.shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-    if (depth == false) {
-        normalMatrix = glm::mat3(glm::inverseTranspose(view * model));
-        glUniformMatrix3fv(glGetUniformLocation(shader.shaderProgram, "normalMatrix"), 1, GL_FALSE, glm::value_ptr(normalMatrix));
+        glDisable(GL_DEPTH_TEST);
+        screenQuad.Draw(screenQuadShader);
+        glEnable(GL_DEPTH_TEST);
     }
-    horse.Draw(shader);
-}
+    else {
+        state.viewport(0, 0, myWindow.getWindowDimensions().width, myWindow.getWindowDimensions().height);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-void renderBow(gps::Shader shader) {
-    model = glm::rotate(glm::mat4(1.0f), glm::radians(-5.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-    model = glm::translate(model, glm::vec3(0.8f, -0.6f, 1.5f));
-    model = glm::scale(model, glm::vec3(1.5f, 1.5f, 1.5f));
-    glUniformMatrix4fv(glGetUniformLocation(shader.shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-    if (depth == false) {
-        normalMatrix = glm::mat3(glm::inverseTranspose(view * model));
-        glUniformMatrix3fv(glGetUniformLocation(shader.shaderProgram, "normalMatrix"), 1, GL_FALSE, glm::value_ptr(normalMatrix));
-    }
-    bow.Draw(shader);
-}
+        WindowDimensions dimensions = myWindow.getWindowDimensions();
+        clusteredLights.update(view, CAMERA_FOV, (float)dimensions.width / (float)dimensions.height, CAMERA_NEAR_PLANE,
+            CAMERA_FAR_PLANE, dimensions.width, dimensions.height);
 
-void renderPlane(gps::Shader shader) {
+        renderQueue.setPassView(gps::PASS_OPAQUE, view, CAMERA_FAR_PLANE);
 
-    if (toMovePlane == true) {
-        if (movePlane >= 10.0) {
-            movePlane = 0.0f;
+        visibleEntities[gps::PASS_OPAQUE] = scene.cull(gps::PASS_OPAQUE, gps::Frustum(projection * view));
+        scene.computeNormalMatrices(view);
+        gps::GpuTimer& shadingTimer = shadingTimers[renderPath][shadowMap.getSettings().filter];
+        shadingTimer.begin();
+        if (renderPath == gps::PATH_DEFERRED) {
+            renderDeferred();
         }
         else {
-            movePlane = movePlane + 0.05;
-        }
-    }
+            shaderStart.useShaderProgram();
+            shaderStart.setMat4("view", view);
+            setLightingUniforms(shaderStart);
 
-    model = glm::translate(glm::mat4(1.0f), glm::vec3(-moveBoat, -0.5f, 2.9f));
-
-    glUniformMatrix4fv(glGetUniformLocation(shader.shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-    if (depth == false) {
-        normalMatrix = glm::mat3(glm::inverseTranspose(view * model));
-        glUniformMatrix3fv(glGetUniformLocation(shader.shaderProgram, "normalMatrix"), 1, GL_FALSE, glm::value_ptr(normalMatrix));
-    }
-    plane.Draw(shader);
-}
-
-void renderLantern(gps::Shader shader) {
-    model = glm::rotate(glm::mat4(1.0f), glm::radians(-5.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-    model = glm::translate(model, glm::vec3(-0.8f, -0.6f, -1.5f));
-    model = glm::scale(model, glm::vec3(1.5f, 1.5f, 1.5f));
-    glUniformMatrix4fv(glGetUniformLocation(shader.shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-    if (depth == false) {
-        normalMatrix = glm::mat3(glm::inverseTranspose(view * model));
-        glUniformMatrix3fv(glGetUniformLocation(shader.shaderProgram, "normalMatrix"), 1, GL_FALSE, glm::value_ptr(normalMatrix));
-    }
-    lantern.Draw(shader);
-}
-
-void renderWolf(gps::Shader shader) {
-    model = glm::rotate(glm::mat4(1.0f), glm::radians(5.0f), glm::vec3(1.0f, 0.0f, 1.0f));
-    model = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -0.5f, 0.0f));
-    glUniformMatrix4fv(glGetUniformLocation(shader.shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-    if (depth == false) {
-        normalMatrix = glm::mat3(glm::inverseTranspose(view * model));
-        glUniformMatrix3fv(glGetUniformLocation(shader.shaderProgram, "normalMatrix"), 1, GL_FALSE, glm::value_ptr(normalMatrix));
-    }
-    wolf.Draw(shader);
-}
-
-void renderArrow(gps::Shader shader) {
-    
-    if (shootArrow == true) {
-       arrowDistance += 0.05f;
+            scene.submit(renderQueue, gps::PASS_OPAQUE, shaderStart);
+            renderQueue.draw(gps::PASS_OPAQUE);
+        }
+        shadingTimer.end();
+        
+        renderLightCube();
     }
-    float move = 1.5f - arrowDistance;
-    
-    model = glm::rotate(glm::mat4(1.0f), glm::radians(-5.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-    model = glm::translate(model, glm::vec3(0.8f, -0.6f, 1.5f));
-    model = glm::scale(model, glm::vec3(1.5f, 1.5f, 1.5f));
-    glUniformMatrix4fv(glGetUniformLocation(shader.shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-    if (depth == false) {
-        normalMatrix = glm::mat3(glm::inverseTranspose(view * model));
-        glUniformMatrix3fv(glGetUniformLocation(shader.shaderProgram, "normalMatrix"), 1, GL_FALSE, glm::value_ptr(normalMatrix));
-    }
-    arrow.Draw(shader);
-}
-
-void renderBoat(gps::Shader shader) {
-    switch (rotateBoat) {
-    case 0:
-        if (moveBoat >= 2.0)
-            rotateBoat = 1;
-        else
-            moveBoat += 0.005f;
-        break;
-    case 1:
-        if (moveBoat <= 0.0f)
-            rotateBoat = 0;
-        else
-            moveBoat -= 0.005f;
-        break;
-    }
-
-    model = glm::translate(glm::mat4(1.0f), glm::vec3(-moveBoat, -0.45f, 2.9f));
     
-    glUniformMatrix4fv(glGetUniformLocation(shader.shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-    if (depth == false) {
-        normalMatrix = glm::mat3(glm::inverseTranspose(view * model));
-        glUniformMatrix3fv(glGetUniformLocation(shader.shaderProgram, "normalMatrix"), 1, GL_FALSE, glm::value_ptr(normalMatrix));
-    }
-    boat.Draw(shader);
+    renderSkyBox();
 }
 
-void renderDucks(gps::Shader shader) {
-    
-    if (toMoveDucks == true) {
-        moveDucks -= 0.001f;
-        if (moveDucks <= 1.5f) {
-            toMoveDucks = false;
+// Times the istream-based, memory-mapped and parallel .obj parsers on the scene
+// models (best of 5 runs each). Run with: Project.exe --bench-obj
+void benchmarkObjParsers() {
+    const char* files[] = {
+        "models/ground/ground4.obj",
+        "models/buildings/campsite.obj",
+        "models/lantern/lantern.obj",
+        "models/cat/cats.obj",
+        "models/duck/movingDucks.obj",
+        "models/horse/horse.obj",
+        "models/duck/staticDucks.obj",
+        "models/bow and arrow/bow.obj",
+        "models/boat/boat.obj",
+    };
+    const int runs = 5;
+
+    for (const char* file : files) {
+        std::string fileName = file;
+        std::string basePath = fileName.substr(0, fileName.find_last_of('/')) + "/";
+        double bestStream = 1e9;
+        double bestMapped = 1e9;
+        double bestParallel = 1e9;
+
+        for (int i = 0; i < runs; i++) {
+            tinyobj::attrib_t attrib;
+            std::vector<tinyobj::shape_t> shapes;
+            std::vector<tinyobj::material_t> materials;
+            std::string err;
+
+            auto start = std::chrono::high_resolution_clock::now();
+            tinyobj::LoadObj(&attrib, &shapes, &materials, &err, file, basePath.c_str(), true);
+            std::chrono::duration<double, std::milli> streamTime = std::chrono::high_resolution_clock::now() - start;
+
+            start = std::chrono::high_resolution_clock::now();
+            tinyobj::LoadObjMapped(&attrib, &shapes, &materials, &err, file, basePath.c_str(), true);
+            std::chrono::duration<double, std::milli> mappedTime = std::chrono::high_resolution_clock::now() - start;
+
+            start = std::chrono::high_resolution_clock::now();
+            tinyobj::LoadObjParallel(&attrib, &shapes, &materials, &err, file, basePath.c_str(), true);
+            std::chrono::duration<double, std::milli> parallelTime = std::chrono::high_resolution_clock::now() - start;
+
+            bestStream = std::min(bestStream, streamTime.count());
+            bestMapped = std::min(bestMapped, mappedTime.count());
+            bestParallel = std::min(bestParallel, parallelTime.count());
         }
-    }
-    model = glm::translate(glm::mat4(1.0f), glm::vec3(moveDucks, -0.5f, 0.0f));
 
-    glUniformMatrix4fv(glGetUniformLocation(shader.shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-    if (depth == false) {
-        normalMatrix = glm::mat3(glm::inverseTranspose(view * model));
-        glUniformMatrix3fv(glGetUniformLocation(shader.shaderProgram, "normalMatrix"), 1, GL_FALSE, glm::value_ptr(normalMatrix));
+        printf("%-36s stream %8.2f ms   mapped %8.2f ms   parallel %8.2f ms\n", file, bestStream, bestMapped, bestParallel);
     }
-    ducks.Draw(shader);
 }
 
-void renderRotatedDuck(gps::Shader shader) {
-   
-    model = glm::rotate(glm::mat4(1.0f), glm::radians(-45.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-    model = glm::translate(model, glm::vec3(-0.05f, -1.55f, -0.9f));
-    glUniformMatrix4fv(glGetUniformLocation(shader.shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-    if (depth == false) {
-        normalMatrix = glm::mat3(glm::inverseTranspose(view * model));
-        glUniformMatrix3fv(glGetUniformLocation(shader.shaderProgram, "normalMatrix"), 1, GL_FALSE, glm::value_ptr(normalMatrix));
-    }
-    rotatedDuck.Draw(shader);
-}
+// Times decoding the textures of models/buildings and models/trees alone, followed by the old
+// byte-wise row flip, and flipped by stb_image while decoding (best of 3 runs each), with the
+// totals over all of them. Run with: Project.exe --bench-textures
+void benchmarkTextureFlip() {
+    const char* files[] = {
+        "models/buildings/Farmhouse Texture.jpg",
+        "models/buildings/MlTXZ.png",
+        "models/buildings/TexturesCom_ConcreteBunkerDirty0076_1_S.jpg",
+        "models/buildings/TexturesCom_WoodRough0129_5_M.jpg",
+        "models/buildings/camp_diffuse.jpg",
+        "models/buildings/pier.png",
+        "models/buildings/rock.png",
+        "models/buildings/roof.jpg",
+        "models/buildings/stone.png",
+        "models/buildings/wood.png",
+        "models/trees/BarkDecidious0143_5_S.jpg",
+        "models/trees/BarkDecidious0194_7_S.jpg",
+        "models/trees/Craggy_Rock_With_Moss_UV_CM_1.jpg",
+        "models/trees/DB2X2_L01.png",
+        "models/trees/Leaves0142_4_S.png",
+        "models/trees/Leaves0156_1_S.png",
+        "models/trees/bark_0004.jpg",
+        "models/trees/blatt1.jpg",
+        "models/trees/pine.png",
+        "models/trees/pineTexture.png",
+    };
+    const int runs = 3;
+    double totalDecode = 0.0;
+    double totalScalarFlip = 0.0;
+    double totalFlipOnLoad = 0.0;
+
+    for (const char* file : files) {
+        double bestDecode = 1e9;
+        double bestScalarFlip = 1e9;
+        double bestFlipOnLoad = 1e9;
+        int x = 0, y = 0, n;
+
+        for (int i = 0; i < runs; i++) {
+            // decode only
+            auto start = std::chrono::high_resolution_clock::now();
+            unsigned char* image_data = stbi_load(file, &x, &y, &n, 4);
+            std::chrono::duration<double, std::milli> decodeTime = std::chrono::high_resolution_clock::now() - start;
+            stbi_image_free(image_data);
+
+            // decode followed by the old byte-by-byte row swap
+            start = std::chrono::high_resolution_clock::now();
+            image_data = stbi_load(file, &x, &y, &n, 4);
+            if (image_data) {
+                int width_in_bytes = x * 4;
+                for (int row = 0; row < y / 2; row++) {
+                    unsigned char* top = image_data + row * width_in_bytes;
+                    unsigned char* bottom = image_data + (y - row - 1) * width_in_bytes;
+                    for (int col = 0; col < width_in_bytes; col++) {
+                        unsigned char temp = top[col];
+                        top[col] = bottom[col];
+                        bottom[col] = temp;
+                    }
+                }
+            }
+            std::chrono::duration<double, std::milli> scalarFlipTime = std::chrono::high_resolution_clock::now() - start;
+            stbi_image_free(image_data);
+
+            // decode with stb_image flipping the rows (what Model3D::ReadTextureFromFile does)
+            start = std::chrono::high_resolution_clock::now();
+            stbi_set_flip_vertically_on_load_thread(1);
+            image_data = stbi_load(file, &x, &y, &n, 4);
+            stbi_set_flip_vertically_on_load_thread(0);
+            std::chrono::duration<double, std::milli> flipOnLoadTime = std::chrono::high_resolution_clock::now() - start;
+            stbi_image_free(image_data);
+
+            bestDecode = std::min(bestDecode, decodeTime.count());
+            bestScalarFlip = std::min(bestScalarFlip, scalarFlipTime.count());
+            bestFlipOnLoad = std::min(bestFlipOnLoad, flipOnLoadTime.count());
+        }
 
-void renderStaticDucks(gps::Shader shader){
-    model = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -0.5f, 0.0f));
-    glUniformMatrix4fv(glGetUniformLocation(shader.shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-    if (depth == false) {
-        normalMatrix = glm::mat3(glm::inverseTranspose(view * model));
-        glUniformMatrix3fv(glGetUniformLocation(shader.shaderProgram, "normalMatrix"), 1, GL_FALSE, glm::value_ptr(normalMatrix));
+        printf("%-64s %5dx%-5d decode %8.2f ms   + scalar flip %8.2f ms   flip on load %8.2f ms\n",
+            file, x, y, bestDecode, bestScalarFlip, bestFlipOnLoad);
+        totalDecode += bestDecode;
+        totalScalarFlip += bestScalarFlip;
+        totalFlipOnLoad += bestFlipOnLoad;
     }
-    staticDucks.Draw(shader);
+    printf("%zu textures: decode %.1f ms   + scalar flip %.1f ms   flip on load %.1f ms\n",
+        sizeof(files) / sizeof(files[0]), totalDecode, totalScalarFlip, totalFlipOnLoad);
 }
 
-void renderScene() {
-
-    processMovement();
-    presentScene();
-
-    depthMapShader.useShaderProgram();
-    glUniformMatrix4fv(glGetUniformLocation(depthMapShader.shaderProgram, "lightSpaceTrMatrix"), 1, GL_FALSE, glm::value_ptr(computeLightSpaceTrMatrix()));
-    glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-    glBindFramebuffer(GL_FRAMEBUFFER, shadowMapFBO);
-    glClear(GL_DEPTH_BUFFER_BIT);
-
-    depth = true;
-
-    renderGround(depthMapShader);
-    renderStructures(depthMapShader);
-    renderCampsite(depthMapShader);
-
-    renderCat(depthMapShader);
-    renderHorse(depthMapShader);
-
-    renderStaticDucks(depthMapShader);
-    renderRotatedDuck(depthMapShader);
-
-    renderLantern(depthMapShader);
-    renderWolf(depthMapShader);
-
-    renderScalableTrees(depthMapShader);
-    renderDucks(depthMapShader);
-    renderBoat(depthMapShader);
-    
-    renderBow(depthMapShader);
-    renderArrow(depthMapShader);
-    renderPlane(depthMapShader);
-
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-
-    if (showDepthMap) {
-        glViewport(0, 0, (float) myWindow.getWindowDimensions().width, (float) myWindow.getWindowDimensions().height);
-        glClear(GL_COLOR_BUFFER_BIT);
-        screenQuadShader.useShaderProgram();
+// Times building, refitting and querying a BVH over many boxes scattered on a plane (best of
+// 5 runs), and the culling of the same objects by the linear SSE sphere test for comparison.
+// Run with: Project.exe --bench-bvh
+void benchmarkBvh() {
+    const size_t counts[] = {100, 1000, 10000, 100000};
+    const int runs = 5;
+    const int queries = 1000;
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    glm::mat4 benchViewProjection = glm::perspective(CAMERA_FOV, 16.0f / 9.0f, CAMERA_NEAR_PLANE, CAMERA_FAR_PLANE)
+        * glm::lookAt(glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(1.0f, 1.8f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    gps::Frustum frustum(benchViewProjection);
+
+    for (size_t count : counts) {
+        // Same density at every count: about one object per 10 x 10 units
+        float extent = 10.0f * std::sqrt((float)count);
+        std::vector<gps::BoundingBox> boxes(count);
+        gps::TransformSystem transforms;
+        for (size_t i = 0; i < count; i++) {
+            glm::vec3 center(extent * unit(random), unit(random), extent * unit(random));
+            glm::vec3 halfSize = glm::vec3(1.0f) + glm::abs(glm::vec3(unit(random), unit(random), unit(random)));
+            boxes[i].min = center - halfSize;
+            boxes[i].max = center + halfSize;
+
+            gps::BoundingSphere sphere;
+            sphere.center = glm::vec3(0.0f);
+            sphere.radius = glm::length(halfSize);
+            transforms.add(glm::translate(glm::mat4(1.0f), center));
+            transforms.setBounds((uint32_t)i, sphere);
+        }
 
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, depthMapTexture);
-        glUniform1i(glGetUniformLocation(screenQuadShader.shaderProgram, "depthMap"), 0);
+        gps::Bvh bvh;
+        std::vector<uint32_t> found;
+        std::vector<uint8_t> visible;
+        double bestBuild = 1e9;
+        double bestRefit = 1e9;
+        double bestFrustum = 1e9;
+        double bestLinear = 1e9;
+        double bestRays = 1e9;
+        double bestOverlaps = 1e9;
+        size_t visibleCount = 0;
+        size_t hits = 0;
+
+        for (int r = 0; r < runs; r++) {
+            auto start = std::chrono::high_resolution_clock::now();
+            bvh.build(boxes);
+            std::chrono::duration<double, std::milli> buildTime = std::chrono::high_resolution_clock::now() - start;
+
+            // every object moved a little, like the animated entities each frame
+            for (size_t i = 0; i < count; i++) {
+                float offset = 0.01f * unit(random);
+                boxes[i].min.x += offset;
+                boxes[i].max.x += offset;
+            }
+            start = std::chrono::high_resolution_clock::now();
+            bvh.refit(boxes);
+            std::chrono::duration<double, std::milli> refitTime = std::chrono::high_resolution_clock::now() - start;
+
+            start = std::chrono::high_resolution_clock::now();
+            found.clear();
+            bvh.queryFrustum(frustum, found);
+            std::chrono::duration<double, std::milli> frustumTime = std::chrono::high_resolution_clock::now() - start;
+            visibleCount = found.size();
+
+            start = std::chrono::high_resolution_clock::now();
+            transforms.cull(frustum, visible);
+            std::chrono::duration<double, std::milli> linearTime = std::chrono::high_resolution_clock::now() - start;
+
+            hits = 0;
+            start = std::chrono::high_resolution_clock::now();
+            for (int q = 0; q < queries; q++) {
+                glm::vec3 origin(extent * unit(random), 0.0f, extent * unit(random));
+                glm::vec3 direction(unit(random), 0.05f * unit(random), unit(random));
+                float distance;
+                hits += bvh.raycast(origin, direction, extent, &distance) >= 0 ? 1 : 0;
+            }
+            std::chrono::duration<double, std::milli> rayTime = std::chrono::high_resolution_clock::now() - start;
+
+            start = std::chrono::high_resolution_clock::now();
+            for (int q = 0; q < queries; q++) {
+                gps::BoundingBox area;
+                area.min = glm::vec3(extent * unit(random), -1.0f, extent * unit(random));
+                area.max = area.min + glm::vec3(20.0f, 2.0f, 20.0f);
+                found.clear();
+                bvh.queryOverlap(area, found);
+            }
+            std::chrono::duration<double, std::milli> overlapTime = std::chrono::high_resolution_clock::now() - start;
+
+            bestBuild = std::min(bestBuild, buildTime.count());
+            bestRefit = std::min(bestRefit, refitTime.count());
+            bestFrustum = std::min(bestFrustum, frustumTime.count());
+            bestLinear = std::min(bestLinear, linearTime.count());
+            bestRays = std::min(bestRays, rayTime.count());
+            bestOverlaps = std::min(bestOverlaps, overlapTime.count());
+        }
 
-        glDisable(GL_DEPTH_TEST);
-        screenQuad.Draw(screenQuadShader);
-        glEnable(GL_DEPTH_TEST);
+        printf("%7zu objects   build %8.3f ms   refit %7.3f ms   frustum %7.3f ms (linear SSE %7.3f ms, %zu visible)   %d rays %7.3f ms (%zu hits)   %d overlaps %7.3f ms\n",
+            count, bestBuild, bestRefit, bestFrustum, bestLinear, visibleCount, queries, bestRays, hits, queries, bestOverlaps);
     }
-    else {
-        glViewport(0, 0, (float)myWindow.getWindowDimensions().width, (float)myWindow.getWindowDimensions().height);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        shaderStart.useShaderProgram();
-        view = myCamera.getViewMatrix();
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-
-        lightRotation = glm::rotate(glm::mat4(1.0f), glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f));
-        glUniform3fv(lightDirLoc, 1, glm::value_ptr(glm::inverseTranspose(glm::mat3(view * lightRotation)) * lightDir));
-
-        glActiveTexture(GL_TEXTURE3);
-        glBindTexture(GL_TEXTURE_2D, depthMapTexture);
-        glUniform1i(glGetUniformLocation(shaderStart.shaderProgram, "shadowMap"), 3);
-        glUniformMatrix4fv(glGetUniformLocation(shaderStart.shaderProgram, "lightSpaceTrMatrix"), 1, GL_FALSE, glm::value_ptr(computeLightSpaceTrMatrix()));
+}
 
-        computePointLight();
-        computeWolfLight();
+// Times the normal matrices of many objects computed one at a time with glm, as the draw loop
+// used to, against one TransformSystem batch (best of 5 runs). Run with: Project.exe --bench-transforms
+void benchmarkTransforms() {
+    const size_t counts[] = {1000, 10000, 100000};
+    const int runs = 5;
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    glm::mat4 benchView = glm::lookAt(glm::vec3(0.0f, 2.0f, 5.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    for (size_t count : counts) {
+        // Half the objects are scaled uniformly, like most of the scene
+        std::vector<glm::mat4> worlds(count);
+        gps::TransformSystem transforms;
+        for (size_t i = 0; i < count; i++) {
+            glm::mat4 world = glm::translate(glm::mat4(1.0f), 10.0f * glm::vec3(unit(random), unit(random), unit(random)));
+            world = glm::rotate(world, 3.0f * unit(random), glm::vec3(unit(random), unit(random), 2.0f + unit(random)));
+            float s = 1.5f + unit(random);
+            worlds[i] = glm::scale(world, i % 2 == 0 ? glm::vec3(s) : glm::vec3(s, 1.5f + unit(random), 1.5f + unit(random)));
+            transforms.add(worlds[i]);
+        }
 
-        depth = false;
+        std::vector<glm::mat3> normals(count);
+        double bestGlm = 1e9;
+        double bestSetWorld = 1e9;
+        double bestBatch = 1e9;
+        float maxError = 0.0f;
 
-        renderGround(shaderStart);
-        renderStructures(shaderStart);
-        renderCampsite(shaderStart);
+        for (int r = 0; r < runs; r++) {
+            auto start = std::chrono::high_resolution_clock::now();
+            for (size_t i = 0; i < count; i++) {
+                normals[i] = glm::mat3(glm::inverseTranspose(benchView * worlds[i]));
+            }
+            std::chrono::duration<double, std::milli> glmTime = std::chrono::high_resolution_clock::now() - start;
 
-        renderCat(shaderStart);
-        renderHorse(shaderStart);
+            // what moving every object costs; static objects skip this
+            start = std::chrono::high_resolution_clock::now();
+            for (size_t i = 0; i < count; i++) {
+                transforms.setWorld((uint32_t)i, worlds[i]);
+            }
+            std::chrono::duration<double, std::milli> setWorldTime = std::chrono::high_resolution_clock::now() - start;
 
-        renderStaticDucks(shaderStart);
-        renderRotatedDuck(shaderStart);
+            start = std::chrono::high_resolution_clock::now();
+            transforms.computeNormalMatrices(benchView);
+            std::chrono::duration<double, std::milli> batchTime = std::chrono::high_resolution_clock::now() - start;
 
-        renderLantern(shaderStart);
-        renderWolf(shaderStart);
+            bestGlm = std::min(bestGlm, glmTime.count());
+            bestSetWorld = std::min(bestSetWorld, setWorldTime.count());
+            bestBatch = std::min(bestBatch, batchTime.count());
+        }
 
-        renderBoat(shaderStart);
-        renderDucks(shaderStart);
-        renderScalableTrees(shaderStart);
+        for (size_t i = 0; i < count; i++) {
+            glm::mat3 batched = transforms.getNormalMatrix((uint32_t)i);
+            for (int column = 0; column < 3; column++) {
+                glm::vec3 difference = glm::abs(batched[column] - normals[i][column]);
+                maxError = std::max(maxError, std::max(difference.x, std::max(difference.y, difference.z)));
+            }
+        }
 
-        renderBow(shaderStart);
-        renderArrow(shaderStart);
-        renderPlane(shaderStart);
-        
-        renderLightCube();
+        printf("%7zu objects   glm per object %8.3f ms   setWorld all %8.3f ms   batch %8.3f ms   max difference %g\n",
+            count, bestGlm, bestSetWorld, bestBatch, maxError);
     }
-    
-    renderSkyBox();
 }
 
 void cleanup() {
+    // Deleted while the context still exists; the loader stops first so no worker is reading a model
+    modelLoader.stop();
+    scene.reset();
+    screenQuad.reset();
+    lightCube.reset();
+    mySkyBox.reset();
+    myBasicShader.reset();
+    deferredShader.reset();
+    depthMapShader.reset();
+    gBufferShader.reset();
+    pointShadowShader.reset();
+    lightCubeShader.reset();
+    screenQuadShader.reset();
+    shaderStart.reset();
+    skyBoxShader.reset();
+    shadowMap.reset();
+    pointShadows.reset();
+    clusteredLights.reset();
+    gBuffer.reset();
+    for (int path = 0; path < gps::RENDER_PATH_COUNT; path++) {
+        for (int filter = 0; filter < gps::FILTER_COUNT; filter++) {
+            shadingTimers[path][filter].reset();
+        }
+    }
     myWindow.Delete();
     //cleanup code for your own data
 }
 
 int main(int argc, const char * argv[]) {
 
+    if (argc > 1 && std::string(argv[1]) == "--bench-obj") {
+        benchmarkObjParsers();
+        return EXIT_SUCCESS;
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--bench-transforms") {
+        benchmarkTransforms();
+        return EXIT_SUCCESS;
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--bench-textures") {
+        benchmarkTextureFlip();
+        return EXIT_SUCCESS;
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--bench-bvh") {
+        benchmarkBvh();
+        return EXIT_SUCCESS;
+    }
+
+    // Shadow quality against cost: Project.exe [--cascades 2-4] [--shadow-size pixels] [--no-shadow-cache]
+    // [--shadow-filter nearest|pcf|pcf-grid|poisson|manual-5x5] [--point-shadow-size pixels] [--point-shadow-updates N]
+    // and lighting cost: [--extra-lights N] [--deferred]
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        if (option == "--cascades" && i + 1 < argc) {
+            shadowSettings.cascadeCount = atoi(argv[++i]);
+        }
+        else if (option == "--shadow-size" && i + 1 < argc) {
+            shadowSettings.resolution = atoi(argv[++i]);
+        }
+        else if (option == "--point-shadow-size" && i + 1 < argc) {
+            pointShadowSettings.resolution = atoi(argv[++i]);
+        }
+        else if (option == "--point-shadow-updates" && i + 1 < argc) {
+            pointShadowSettings.updatesPerFrame = atoi(argv[++i]);
+        }
+        else if (option == "--extra-lights" && i + 1 < argc) {
+            extraLights = std::max(atoi(argv[++i]), 0);
+        }
+        else if (option == "--deferred") {
+            renderPath = gps::PATH_DEFERRED;
+        }
+        else if (option == "--no-shadow-cache") {
+            shadowSettings.cacheStatic = false;
+        }
+        else if (option == "--shadow-filter" && i + 1 < argc) {
+            std::string name = argv[++i];
+            for (int filter = 0; filter < gps::FILTER_COUNT; filter++) {
+                if (name == gps::getShadowFilterName((gps::SHADOW_FILTER)filter)) {
+                    shadowSettings.filter = (gps::SHADOW_FILTER)filter;
+                }
+            }
+        }
+    }
+
     try {
         initOpenGLWindow();
     } catch (const std::exception& e) {
@@ -885,21 +1097,118 @@ int main(int argc, const char * argv[]) {
     initOpenGLState();
     initFBOs();
     initSkyBox();
-	initModels();
+    if (!initModels()) {
+        std::cerr << "ERROR: could not load " << SCENE_FILE << std::endl;
+        cleanup();
+        return EXIT_FAILURE;
+    }
 	initShaders();
 	initUniforms();
     setWindowCallbacks();
 
 	glCheckError();
+	size_t steadyFrames = 0;
+	size_t steadyAllocations = 0;
+	size_t steadyVisibleEntities[gps::PASS_COUNT] = {0, 0};
+	size_t steadyStaticCascades = 0;
+	size_t steadyVisibleLights = 0;
+	size_t steadyLightAssignments = 0;
+	double steadyPathSeconds[gps::RENDER_PATH_COUNT] = {0.0, 0.0};
+	size_t steadyPathFrames[gps::RENDER_PATH_COUNT] = {0, 0};
+	bool allocationsReported = false;
+	double previousTime = glfwGetTime();
+	double updateTime = 0.0;
+
 	// application loop
 	while (!glfwWindowShouldClose(myWindow.getWindow())) {
-        processMovement();
-	    renderScene();
+        bool steadyState = modelsLoaded;
+        size_t frameStartAllocations = gps::getAllocationCount();
+        if (steadyState && steadyFrames == 0) {
+            gps::GLState::getInstance().resetStats();
+        }
+
+        modelLoader.uploadReady(UPLOAD_BUDGET_MS);
+        if (!modelsLoaded && modelLoader.isIdle()) {
+            modelsLoaded = true;
+            gps::TextureCache::getInstance().printStats();
+        }
+
+        double currentTime = glfwGetTime();
+        updateTime += currentTime - previousTime;
+        previousTime = currentTime;
+        int updates = 0;
+        while (updateTime >= UPDATE_STEP && updates < MAX_UPDATES_PER_FRAME) {
+            updateSimulation();
+            updateTime -= UPDATE_STEP;
+            updates++;
+        }
+        if (updates == MAX_UPDATES_PER_FRAME) {
+            updateTime = std::min(updateTime, UPDATE_STEP);
+        }
+        gps::RENDER_PATH framePath = renderPath;
+        double renderStart = glfwGetTime();
+	    renderScene((float)(updateTime / UPDATE_STEP));
+        double renderSeconds = glfwGetTime() - renderStart;
 
 		glfwPollEvents();
 		glfwSwapBuffers(myWindow.getWindow());
 
 		glCheckError();
+
+        if (steadyState) {
+            steadyAllocations += gps::getAllocationCount() - frameStartAllocations;
+            for (int pass = 0; pass < gps::PASS_COUNT; pass++) {
+                steadyVisibleEntities[pass] += visibleEntities[pass];
+            }
+            steadyStaticCascades += staticCascadesDrawn;
+            steadyVisibleLights += clusteredLights.getVisibleLightCount();
+            steadyLightAssignments += clusteredLights.getAssignmentCount();
+            steadyPathSeconds[framePath] += renderSeconds;
+            steadyPathFrames[framePath]++;
+            if (++steadyFrames == ALLOCATION_REPORT_FRAMES) {
+                double visible = (double)steadyVisibleEntities[gps::PASS_OPAQUE] / steadyFrames;
+                double casters = (double)steadyVisibleEntities[gps::PASS_SHADOW] / steadyFrames;
+                printf("Culling          : %.1f visible, %.1f culled of %zu entities; %.1f casters drawn into %d shadow cascades per frame\n",
+                    visible, scene.getEntityCount() - visible, scene.getEntityCount(), casters, shadowMap.getSettings().cascadeCount);
+                if (shadowMap.getSettings().cacheStatic) {
+                    printf("Shadow cache     : static casters redrawn into %zu of %zu cascade layers\n",
+                        steadyStaticCascades, steadyFrames * shadowMap.getSettings().cascadeCount);
+                }
+                printf("Point shadows    : %zu light cubes redrawn in %zu frames\n", pointShadows.takeUpdateCount(), steadyFrames);
+                printf("Point lights     : %.1f of %zu in view, %.1f light-cluster pairs per frame\n",
+                    (double)steadyVisibleLights / steadyFrames, clusteredLights.getLightCount(), (double)steadyLightAssignments / steadyFrames);
+                // Comparable between paths and filters only when measured from the same view
+                for (int path = 0; path < gps::RENDER_PATH_COUNT; path++) {
+                    if (steadyPathFrames[path] > 0) {
+                        printf("Render CPU       : %.3f ms with %s shading (%zu frames)\n",
+                            1000.0 * steadyPathSeconds[path] / steadyPathFrames[path], gps::getRenderPathName((gps::RENDER_PATH)path), steadyPathFrames[path]);
+                    }
+                    for (int filter = 0; filter < gps::FILTER_COUNT; filter++) {
+                        gps::GpuTimer& timer = shadingTimers[path][filter];
+                        timer.collect();
+                        if (timer.getSampleCount() > 0) {
+                            printf("Shading GPU      : %.3f ms with %s shading and the %s shadow filter (%zu frames)\n", timer.getAverageMs(),
+                                gps::getRenderPathName((gps::RENDER_PATH)path), gps::getShadowFilterName((gps::SHADOW_FILTER)filter), timer.getSampleCount());
+                            timer.clear();
+                        }
+                    }
+                    steadyPathSeconds[path] = 0.0;
+                    steadyPathFrames[path] = 0;
+                }
+                if (!allocationsReported || steadyAllocations > 0) {
+                    printf("Heap allocations : %zu in the last %zu frames\n", steadyAllocations, steadyFrames);
+                    if (!allocationsReported) {
+                        gps::GLState::getInstance().printStats(steadyFrames);
+                    }
+                    allocationsReported = true;
+                }
+                steadyFrames = 0;
+                steadyAllocations = 0;
+                steadyVisibleEntities[gps::PASS_OPAQUE] = 0;
+                steadyVisibleEntities[gps::PASS_SHADOW] = 0;
+                steadyStaticCascades = 0;
+            }
+        }
 	}
 
 	cleanup();
@@ -0,0 +1,49 @@
+#version 410 core
+
+// Lights the pixels of the G-buffer like shaderStart.frag lights its fragments; the surface it
+// reads from its inputs is rebuilt from the G-buffer instead
+out vec4 fColor;
+
+vec3 fNormal;
+vec4 fPosEye;
+vec4 fPosWorld;
+
+uniform sampler2D gAlbedo;
+uniform sampler2D gNormal;
+uniform sampler2D gSpecular;
+uniform sampler2D gDepth;
+uniform mat4 inverseProjection;
+uniform mat4 inverseView;
+
+#include "lighting.glsl"
+
+void main(){
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	float depth = texelFetch(gDepth, pixel, 0).r;
+	// nothing was drawn here; left to the sky box
+	if(depth == 1.0f){
+		discard;
+	}
+	gl_FragDepth = depth;
+
+	vec4 positionEye = inverseProjection * vec4(vec3(gl_FragCoord.xy / vec2(textureSize(gDepth, 0)), depth) * 2.0f - 1.0f, 1.0f);
+	fPosEye = vec4(positionEye.xyz / positionEye.w, 1.0f);
+	fPosWorld = inverseView * fPosEye;
+	fNormal = texelFetch(gNormal, pixel, 0).xyz;
+	vec3 diffuseColor = texelFetch(gAlbedo, pixel, 0).rgb;
+	vec3 specularColor = texelFetch(gSpecular, pixel, 0).rgb;
+
+	computeLightComponents();
+	ambient *= diffuseColor;
+	diffuse *= diffuseColor;
+	specular *= specularColor;
+
+	vec3 pointColor = computePointLights(diffuseColor, specularColor);
+
+	float shadow = computeShadow();
+	vec3 color = min((ambient + (1.0f - shadow) * diffuse) + (1.0f - shadow) * specular, 1.0f);
+	
+	float fogFactor = computeFog();
+	vec3 fogColor = vec3(0.5f, 0.5f, 0.5f);
+	fColor = vec4(fogColor * (1 - fogFactor) + color * fogFactor + pointColor, 1.0f);
+}
\ No newline at end of file
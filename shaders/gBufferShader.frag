@@ -0,0 +1,19 @@
+#version 410 core
+
+in vec3 fNormal;
+in vec2 fTexCoords;
+
+// the G-buffer attachments, in the order of gps::GBuffer
+layout(location = 0) out vec4 gAlbedo;
+layout(location = 1) out vec4 gNormal;
+layout(location = 2) out vec4 gSpecular;
+
+//texture
+uniform sampler2D diffuseTexture;
+uniform sampler2D specularTexture;
+
+void main(){
+	gAlbedo = vec4(texture(diffuseTexture, fTexCoords).rgb, 1.0f);
+	gNormal = vec4(normalize(fNormal), 0.0f);
+	gSpecular = vec4(texture(specularTexture, fTexCoords).rgb, 1.0f);
+}
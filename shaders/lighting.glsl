@@ -0,0 +1,225 @@
+// Directional light with cascaded shadows, clustered point lights with cube shadows and fog,
+// shared by shaderStart.frag and deferredShader.frag. The including shader declares the surface
+// first: fNormal and fPosEye in eye space, fPosWorld in world space
+
+//lighting
+uniform vec3 lightDir;
+uniform vec3 lightColor;
+
+// one layer per cascade; cascade i covers view distances up to cascadeSplits[i]. The same
+// texture is bound twice: with hardware depth comparison and as plain depth values
+uniform sampler2DArrayShadow shadowMap;
+uniform sampler2DArray shadowDepth;
+uniform int cascadeCount;
+uniform float cascadeSplits[4];
+uniform mat4 lightSpaceTrMatrices[4];
+// filter modes, in the order of gps::SHADOW_FILTER
+const int FILTER_NEAREST = 0;
+const int FILTER_PCF = 1;
+const int FILTER_PCF_GRID = 2;
+const int FILTER_POISSON = 3;
+const int FILTER_MANUAL_5X5 = 4;
+uniform int shadowFilter;
+uniform float shadowTexelSize;
+uniform float shadowFilterRadius;
+// in texels of depth; the slope bias is scaled by how far the filter reaches
+uniform float shadowConstantBias;
+uniform float shadowSlopeBias;
+
+// point light cubes: distance to the light over its radius, compared in hardware; the cube
+// of each light, or -1 if it has none
+uniform samplerCubeArrayShadow pointShadowMaps;
+uniform vec3 pointShadowPositions[4];
+uniform float pointShadowRadii[4];
+uniform float pointShadowResolution;
+
+// point lights, grouped by cluster: screen tiles of the grid by depth slices that grow with the
+// distance (gps::ClusteredLights). Two texels per light: eye space position and radius, color
+// and shadow cube. A cluster's range is its offset and count in the index list
+const int CLUSTER_TILES_X = 16;
+const int CLUSTER_TILES_Y = 9;
+const int CLUSTER_SLICES = 24;
+uniform samplerBuffer clusterLights;
+uniform usamplerBuffer clusterRanges;
+uniform usamplerBuffer clusterIndices;
+uniform vec2 clusterTileScale;
+uniform float clusterSliceScale;
+uniform float clusterSliceBias;
+
+const vec2 poissonDisk[16] = vec2[](
+	vec2(-0.94201624f, -0.39906216f), vec2(0.94558609f, -0.76890725f),
+	vec2(-0.09418410f, -0.92938870f), vec2(0.34495938f, 0.29387760f),
+	vec2(-0.91588581f, 0.45771432f), vec2(-0.81544232f, -0.87912464f),
+	vec2(-0.38277543f, 0.27676845f), vec2(0.97484398f, 0.75648379f),
+	vec2(0.44323325f, -0.97511554f), vec2(0.53742981f, -0.47373420f),
+	vec2(-0.26496911f, -0.41893023f), vec2(0.79197514f, 0.19090188f),
+	vec2(-0.24188840f, 0.99706507f), vec2(-0.81409955f, 0.91437590f),
+	vec2(0.19984126f, 0.78641367f), vec2(0.14383161f, -0.14100790f)
+);
+
+vec3 ambient;
+vec3 diffuse;
+vec3 specular;
+
+float ambientStrength = 0.2f;
+float specularStrength = 0.5f;
+float shininess = 32.0f;
+
+float constant = 2.0f;
+float linear = 0.4f;
+float quadratic = 0.3f; 
+
+float computeShadow(){
+
+	float viewDistance = -fPosEye.z;
+	if(viewDistance > cascadeSplits[cascadeCount - 1]){
+		return 0.0f;
+	}
+	int cascade = 0;
+	while(cascade < cascadeCount - 1 && viewDistance > cascadeSplits[cascade]){
+		cascade++;
+	}
+
+	vec4 fPosLightSpace = lightSpaceTrMatrices[cascade] * fPosWorld;
+	vec3 normalizedCoords = fPosLightSpace.xyz / fPosLightSpace.w;
+
+	normalizedCoords = normalizedCoords * 0.5 + 0.5;
+
+	if(normalizedCoords.z > 1.0f){
+		return 0.0f;
+	}
+
+	// Each cascade's depth range is as wide as its texture, so one texel of a surface at angle
+	// theta to the light spans tan(theta) texels of depth in every cascade
+	float cosTheta = clamp(dot(normalize(fNormal), normalize(lightDir)), 0.1f, 1.0f);
+	float tanTheta = sqrt(1.0f - cosTheta * cosTheta) / cosTheta;
+	float reach = 1.0f;
+	if(shadowFilter == FILTER_PCF_GRID || shadowFilter == FILTER_MANUAL_5X5){
+		reach = 2.0f;
+	}
+	else if(shadowFilter == FILTER_POISSON){
+		reach = shadowFilterRadius + 1.0f;
+	}
+	float bias = (shadowConstantBias + shadowSlopeBias * reach * tanTheta) * shadowTexelSize;
+	float currentDepth = normalizedCoords.z - bias;
+	vec2 coords = normalizedCoords.xy;
+
+	if(shadowFilter == FILTER_NEAREST){
+		float closestDepth = texture(shadowDepth, vec3(coords, cascade)).r;
+		return currentDepth > closestDepth ? 1.0f : 0.0f;
+	}
+
+	if(shadowFilter == FILTER_MANUAL_5X5){
+		float shadow = 0.0f;
+		for(int y = -2; y <= 2; y++){
+			for(int x = -2; x <= 2; x++){
+				float closestDepth = texture(shadowDepth, vec3(coords + vec2(x, y) * shadowTexelSize, cascade)).r;
+				shadow += currentDepth > closestDepth ? 1.0f : 0.0f;
+			}
+		}
+		return shadow / 25.0f;
+	}
+
+	// The comparisons return 1 where lit, already filtered over 2x2 texels
+	float lit = 0.0f;
+	if(shadowFilter == FILTER_PCF_GRID){
+		for(int y = -1; y <= 1; y++){
+			for(int x = -1; x <= 1; x++){
+				lit += texture(shadowMap, vec4(coords + vec2(x, y) * shadowTexelSize, cascade, currentDepth));
+			}
+		}
+		lit /= 9.0f;
+	}
+	else if(shadowFilter == FILTER_POISSON){
+		// Interleaved gradient noise turns the disk per pixel, trading banding for fine noise
+		float noise = fract(52.9829189f * fract(dot(gl_FragCoord.xy, vec2(0.06711056f, 0.00583715f))));
+		float angle = 6.2831853f * noise;
+		mat2 rotation = mat2(cos(angle), sin(angle), -sin(angle), cos(angle));
+		for(int i = 0; i < 16; i++){
+			vec2 offset = rotation * poissonDisk[i] * shadowFilterRadius * shadowTexelSize;
+			lit += texture(shadowMap, vec4(coords + offset, cascade, currentDepth));
+		}
+		lit /= 16.0f;
+	}
+	else{
+		lit = texture(shadowMap, vec4(coords, cascade, currentDepth));
+	}
+	return 1.0f - lit;
+}
+
+float computePointShadow(int cube, float cosTheta){
+	if(cube < 0){
+		return 0.0f;
+	}
+
+	vec3 toFragment = fPosWorld.xyz - pointShadowPositions[cube];
+	float distance = length(toFragment);
+	float depth = distance / pointShadowRadii[cube];
+	if(depth >= 1.0f){
+		return 0.0f;
+	}
+
+	// A texel of a face spans about 2 * distance / resolution at this distance
+	cosTheta = clamp(cosTheta, 0.1f, 1.0f);
+	float tanTheta = sqrt(1.0f - cosTheta * cosTheta) / cosTheta;
+	float bias = (1.0f + tanTheta) * 2.0f * distance / (pointShadowResolution * pointShadowRadii[cube]);
+	return 1.0f - texture(pointShadowMaps, vec4(toFragment, cube), depth - bias);
+}
+
+vec3 computePointLights(vec3 diffuseColor, vec3 specularColor){
+
+	vec3 viewDirN = normalize(-fPosEye.xyz);
+	vec3 normalEye = normalize(fNormal);
+
+	ivec2 tile = min(ivec2(gl_FragCoord.xy * clusterTileScale), ivec2(CLUSTER_TILES_X - 1, CLUSTER_TILES_Y - 1));
+	int slice = clamp(int(log(-fPosEye.z) * clusterSliceScale + clusterSliceBias), 0, CLUSTER_SLICES - 1);
+	uvec2 range = texelFetch(clusterRanges, (slice * CLUSTER_TILES_Y + tile.y) * CLUSTER_TILES_X + tile.x).rg;
+
+	vec3 color = vec3(0.0f);
+	for(uint i = 0u; i < range.y; i++){
+		int light = int(texelFetch(clusterIndices, int(range.x + i)).r);
+		vec4 positionRadius = texelFetch(clusterLights, 2 * light);
+		vec4 colorShadow = texelFetch(clusterLights, 2 * light + 1);
+
+		vec3 toLight = positionRadius.xyz - fPosEye.xyz;
+		float distance = length(toLight);
+		vec3 lightDirN = toLight / distance;
+		vec3 reflection = reflect(-lightDirN, normalEye);
+		float specCoeff = pow(max(dot(viewDirN, reflection), 0.0f), shininess);
+
+		// The window takes the falloff to zero at the radius, where the light leaves its clusters
+		float window = clamp(1.0f - pow(distance / positionRadius.w, 4.0f), 0.0f, 1.0f);
+		float att = window * window / (constant + linear * distance + quadratic * (distance * distance));
+		float lit = 1.0f - computePointShadow(int(colorShadow.w), dot(normalEye, lightDirN));
+
+		vec3 lightAmbient = att * ambientStrength * colorShadow.rgb;
+		vec3 lightDiffuse = lit * att * max(dot(normalEye, lightDirN), 0.0f) * colorShadow.rgb;
+		vec3 lightSpecular = lit * att * specularStrength * specCoeff * colorShadow.rgb;
+		color += min((lightAmbient + lightDiffuse) * 3 * diffuseColor + lightSpecular * 3 * specularColor, 1.0f);
+	}
+	return color;
+}
+
+
+void computeLightComponents(){
+	vec3 cameraPosEye = vec3(0.0f);
+	vec3 normalEye = normalize(fNormal);
+	vec3 lightDirN = normalize(lightDir);
+	vec3 viewDirN = normalize(cameraPosEye - fPosEye.xyz);
+
+	vec3 reflection = reflect(-lightDirN, normalEye);
+	//vec3 halfVector = normalize(lightDirN + viewDirN);
+	float specCoeff = pow(max(dot(viewDirN, reflection), 0.0f), shininess);
+	//float specCoeff = pow(max(dot(halfVector, normalEye), 0.0f), shininess);
+	
+	ambient = ambientStrength * lightColor;
+	diffuse = max(dot(normalEye, lightDirN), 0.0f) * lightColor;
+	specular = specularStrength * specCoeff * lightColor;
+}
+
+float computeFog(){
+	float fogDensity = 0.1f; 
+	float fragmentDistance = length(fPosEye);
+	float fogFactor = exp(-pow(fragmentDistance * fogDensity / 2, 2));
+	return clamp(fogFactor, 0.0f, 1.0f);
+}
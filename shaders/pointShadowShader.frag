@@ -0,0 +1,11 @@
+#version 410 core
+
+in vec4 fPosWorld;
+
+uniform vec3 lightPosition;
+uniform float farPlane;
+
+void main(){
+	// Distance to the light, so the lookup does not depend on the face
+	gl_FragDepth = length(fPosWorld.xyz - lightPosition) / farPlane;
+}
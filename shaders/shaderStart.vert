@@ -7,18 +7,17 @@ layout (location = 2) in vec2 vTexCoords;
 out vec3 fNormal;
 out vec4 fPosEye;
 out vec2 fTexCoords;
-out vec4 fPosLightSpace;
+out vec4 fPosWorld;
 
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 uniform mat3 normalMatrix;
-uniform mat4 lightSpaceTrMatrix;
 
 void main(){
 	fPosEye = view * model * vec4(vPosition, 1.0f);
 	fNormal = normalize(normalMatrix * vNormal);
 	fTexCoords = vTexCoords;
-	fPosLightSpace = lightSpaceTrMatrix * model * vec4(vPosition, 1.0f);
+	fPosWorld = model * vec4(vPosition, 1.0f);
 	gl_Position = projection * view * model * vec4(vPosition, 1.0f);
 }
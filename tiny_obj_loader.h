@@ -195,6 +195,33 @@ namespace tinyobj {
         std::istream &m_inStream;
     };
     
+    /// Read-only view of a whole file mapped into memory.
+    class MappedFile {
+    public:
+        MappedFile();
+        ~MappedFile();
+        
+        /// Maps `filename`; returns false if it cannot be opened or mapped.
+        bool open(const char *filename);
+        void close();
+        
+        const char *data() const { return m_data; }
+        size_t size() const { return m_size; }
+        
+    private:
+        MappedFile(const MappedFile &);
+        MappedFile &operator=(const MappedFile &);
+        
+        const char *m_data;
+        size_t m_size;
+#ifdef _WIN32
+        void *m_file;     // HANDLE
+        void *m_mapping;  // HANDLE
+#else
+        int m_fd;
+#endif
+    };
+    
     /// Loads .obj from a file.
     /// 'attrib', 'shapes' and 'materials' will be filled with parsed shape data
     /// 'shapes' will be filled with parsed shape data
@@ -207,7 +234,26 @@ namespace tinyobj {
                  std::vector<material_t> *materials, std::string *err,
                  const char *filename, const char *mtl_basepath = NULL,
                  bool triangulate = true);
-    
+
+    /// Loads .obj from a file by mapping it into memory and parsing the mapped
+    /// bytes in place, without copying each line into a std::string first.
+    /// Produces exactly the same 'attrib', 'shapes' and 'materials' as
+    /// LoadObj(), and takes the same arguments.
+    bool LoadObjMapped(attrib_t *attrib, std::vector<shape_t> *shapes,
+                       std::vector<material_t> *materials, std::string *err,
+                       const char *filename, const char *mtl_basepath = NULL,
+                       bool triangulate = true);
+
+    /// Same as LoadObjMapped(), but splits the file at line boundaries and
+    /// tokenizes the chunks on `num_threads` worker threads (0 = one per core).
+    /// Chunk-local results are merged in file order, with relative (negative)
+    /// indices rebased onto the vertices of the preceding chunks.
+    /// Small files are parsed on the calling thread.
+    bool LoadObjParallel(attrib_t *attrib, std::vector<shape_t> *shapes,
+                         std::vector<material_t> *materials, std::string *err,
+                         const char *filename, const char *mtl_basepath = NULL,
+                         bool triangulate = true, unsigned int num_threads = 0);
+
     /// Loads .obj from a file with custom user callback.
     /// .mtl is loaded as usual and parsed material_t data will be passed to
     /// `callback.mtllib_cb`.
@@ -245,6 +291,22 @@ namespace tinyobj {
 
 #include <fstream>
 #include <sstream>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 namespace tinyobj {
     
@@ -272,6 +334,102 @@ namespace tinyobj {
         std::vector<float> vn;
         std::vector<float> vt;
     };
+
+    // Bits of face_group::relative: which members of a vertex_index came
+    // from a negative (relative) .obj index.
+    enum {
+        RELATIVE_V = 1,
+        RELATIVE_VT = 2,
+        RELATIVE_VN = 4
+    };
+
+    // Faces of the current group, stored flat: face i is made of the next
+    // `sizes[i]` entries of `vertices`. Avoids one heap allocation per face.
+    struct face_group {
+        std::vector<vertex_index> vertices;
+        std::vector<int> sizes;
+        // RELATIVE_* bits per entry of `vertices`, only filled in once a face
+        // uses relative indices. Lets chunks parsed in parallel be rebased.
+        std::vector<unsigned char> relative;
+
+        face_group() : hasRelative(false) {}
+
+        bool empty() const { return sizes.empty(); }
+        void clear() {
+            vertices.clear();
+            sizes.clear();
+            relative.clear();
+            hasRelative = false;
+        }
+        void push(const vertex_index &vi, unsigned char rel) {
+            if (rel && !hasRelative) {
+                relative.resize(vertices.size(), 0);
+                hasRelative = true;
+            }
+            vertices.push_back(vi);
+            if (hasRelative) relative.push_back(rel);
+        }
+
+        bool hasRelative;
+    };
+
+    MappedFile::MappedFile() : m_data(NULL), m_size(0) {
+#ifdef _WIN32
+        m_file = INVALID_HANDLE_VALUE;
+        m_mapping = NULL;
+#else
+        m_fd = -1;
+#endif
+    }
+    
+    MappedFile::~MappedFile() { close(); }
+    
+    bool MappedFile::open(const char *filename) {
+        close();
+#ifdef _WIN32
+        m_file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+                             OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (m_file == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(m_file, &size)) return false;
+        m_size = static_cast<size_t>(size.QuadPart);
+        // Mapping an empty file fails, but an empty file is a valid .obj.
+        if (m_size == 0) return true;
+        m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (!m_mapping) return false;
+        m_data = static_cast<const char *>(
+                                           MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+        return m_data != NULL;
+#else
+        m_fd = ::open(filename, O_RDONLY);
+        if (m_fd < 0) return false;
+        struct stat st;
+        if (fstat(m_fd, &st) != 0) return false;
+        m_size = static_cast<size_t>(st.st_size);
+        if (m_size == 0) return true;
+        void *p = mmap(NULL, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+        if (p == MAP_FAILED) return false;
+        madvise(p, m_size, MADV_SEQUENTIAL);
+        m_data = static_cast<const char *>(p);
+        return true;
+#endif
+    }
+    
+    void MappedFile::close() {
+#ifdef _WIN32
+        if (m_data) UnmapViewOfFile(m_data);
+        if (m_mapping) CloseHandle(m_mapping);
+        if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+        m_file = INVALID_HANDLE_VALUE;
+        m_mapping = NULL;
+#else
+        if (m_data) munmap(const_cast<char *>(m_data), m_size);
+        if (m_fd >= 0) ::close(m_fd);
+        m_fd = -1;
+#endif
+        m_data = NULL;
+        m_size = 0;
+    }
     
     // See
     // http://stackoverflow.com/questions/6089231/getting-std-ifstream-to-handle-lf-cr-and-crlf
@@ -510,6 +668,42 @@ namespace tinyobj {
         (*z) = parseFloat(token);
         (*w) = parseFloat(token, 1.0);
     }
+
+    // Bounded variants of the helpers above. They never read at or past `end`,
+    // so they also work on lines that are not NUL-terminated, e.g. lines
+    // inside a memory-mapped file.
+    static inline const char *skipSpace(const char *token, const char *end) {
+        while (token < end && IS_SPACE(*token)) token++;
+        return token;
+    }
+
+    static inline float parseFloat(const char **token, const char *end) {
+        const char *s = skipSpace(*token, end);
+        const char *e = s;
+        while (e < end && !IS_SPACE(*e) && *e != '\r') e++;
+        double val = 0.0;
+        tryParseDouble(s, e, &val);
+        (*token) = e;
+        return static_cast<float>(val);
+    }
+
+    // Same as atoi() followed by skipping to the next '/', space or '\r'.
+    static inline int parseInt(const char **token, const char *end) {
+        const char *p = *token;
+        int sign = 1;
+        if (p < end && (*p == '+' || *p == '-')) {
+            if (*p == '-') sign = -1;
+            p++;
+        }
+        int i = 0;
+        while (p < end && IS_DIGIT(*p)) {
+            i = i * 10 + (*p - '0');
+            p++;
+        }
+        while (p < end && *p != '/' && !IS_SPACE(*p) && *p != '\r') p++;
+        (*token) = p;
+        return sign * i;
+    }
     
     static tag_sizes parseTagTriple(const char **token) {
         tag_sizes ts;
@@ -534,40 +728,47 @@ namespace tinyobj {
         return ts;
     }
     
+    // fixIndex() that also records in `relative` when `idx` was relative.
+    static inline int fixIndex(int idx, int n, unsigned char *relative,
+                               unsigned char bit) {
+        if (idx < 0) (*relative) |= bit;
+        return fixIndex(idx, n);
+    }
+
     // Parse triples with index offsets: i, i/j/k, i//k, i/j
-    static vertex_index parseTriple(const char **token, int vsize, int vnsize,
-                                    int vtsize) {
+    // RELATIVE_* bits are set in `relative` for members given as negative
+    // indices.
+    static vertex_index parseTriple(const char **token, const char *end,
+                                    int vsize, int vnsize, int vtsize,
+                                    unsigned char *relative) {
         vertex_index vi(-1);
-        
-        vi.v_idx = fixIndex(atoi((*token)), vsize);
-        (*token) += strcspn((*token), "/ \t\r");
-        if ((*token)[0] != '/') {
+        (*relative) = 0;
+
+        vi.v_idx = fixIndex(parseInt(token, end), vsize, relative, RELATIVE_V);
+        if ((*token) >= end || (*token)[0] != '/') {
             return vi;
         }
         (*token)++;
-        
+
         // i//k
-        if ((*token)[0] == '/') {
+        if ((*token) < end && (*token)[0] == '/') {
             (*token)++;
-            vi.vn_idx = fixIndex(atoi((*token)), vnsize);
-            (*token) += strcspn((*token), "/ \t\r");
+            vi.vn_idx = fixIndex(parseInt(token, end), vnsize, relative, RELATIVE_VN);
             return vi;
         }
-        
+
         // i/j/k or i/j
-        vi.vt_idx = fixIndex(atoi((*token)), vtsize);
-        (*token) += strcspn((*token), "/ \t\r");
-        if ((*token)[0] != '/') {
+        vi.vt_idx = fixIndex(parseInt(token, end), vtsize, relative, RELATIVE_VT);
+        if ((*token) >= end || (*token)[0] != '/') {
             return vi;
         }
-        
+
         // i/j/k
         (*token)++;  // skip '/'
-        vi.vn_idx = fixIndex(atoi((*token)), vnsize);
-        (*token) += strcspn((*token), "/ \t\r");
+        vi.vn_idx = fixIndex(parseInt(token, end), vnsize, relative, RELATIVE_VN);
         return vi;
     }
-    
+
     // Parse raw triples: i, i/j/k, i//k, i/j
     static vertex_index parseRawTriple(const char **token) {
         vertex_index vi(static_cast<int>(0));  // 0 is an invalid index in OBJ
@@ -639,7 +840,7 @@ namespace tinyobj {
     }
     
     static bool exportFaceGroupToShape(
-                                       shape_t *shape, const std::vector<std::vector<vertex_index> > &faceGroup,
+                                       shape_t *shape, const face_group &faceGroup,
                                        const std::vector<tag_t> &tags, const int material_id,
                                        const std::string &name, bool triangulate) {
         if (faceGroup.empty()) {
@@ -647,16 +848,22 @@ namespace tinyobj {
         }
         
         // Flatten vertices and indices
-        for (size_t i = 0; i < faceGroup.size(); i++) {
-            const std::vector<vertex_index> &face = faceGroup[i];
-            
-            vertex_index i0 = face[0];
-            vertex_index i1(-1);
-            vertex_index i2 = face[1];
-            
-            size_t npolys = face.size();
+        const vertex_index *face =
+        faceGroup.vertices.empty() ? NULL : &faceGroup.vertices[0];
+        for (size_t i = 0; i < faceGroup.sizes.size(); i++) {
+            size_t npolys = static_cast<size_t>(faceGroup.sizes[i]);
+            const vertex_index *next = face + npolys;
             
             if (triangulate) {
+                if (npolys < 3) {
+                    face = next;
+                    continue;
+                }
+                
+                vertex_index i0 = face[0];
+                vertex_index i1(-1);
+                vertex_index i2 = face[1];
+                
                 // Polygon -> triangle fan conversion
                 for (size_t k = 2; k < npolys; k++) {
                     i1 = i2;
@@ -693,6 +900,7 @@ namespace tinyobj {
                                                         static_cast<unsigned char>(npolys));
                 shape->mesh.material_ids.push_back(material_id);  // per face
             }
+            face = next;
         }
         
         shape->name = name;
@@ -1055,6 +1263,275 @@ namespace tinyobj {
         return true;
     }
     
+    // Parser state carried from one .obj line to the next.
+    struct obj_parse_state {
+        std::vector<float> v;
+        std::vector<float> vn;
+        std::vector<float> vt;
+        std::vector<tag_t> tags;
+        face_group faceGroup;
+        std::string name;
+        
+        // material
+        std::map<std::string, int> material_map;
+        int material;
+        
+        shape_t shape;
+        
+        obj_parse_state() : material(-1) {}
+    };
+    
+    // Parses one .obj line. `token` points at the first non-space character,
+    // `lineEnd` just past the last character (newline already stripped).
+    // 'v', 'vn', 'vt' and 'f' lines are only read inside [token, lineEnd) plus
+    // one byte past the keyword; every other command expects `*lineEnd` to be
+    // '\0'.
+    // Returns false when a referenced .mtl could not be loaded.
+    static bool parseObjLine(obj_parse_state *st, std::vector<shape_t> *shapes,
+                             std::vector<material_t> *materials, std::string *err,
+                             MaterialReader *readMatFn, bool triangulate,
+                             const char *token, const char *lineEnd) {
+        // vertex
+        if (token[0] == 'v' && IS_SPACE((token[1]))) {
+            token += 2;
+            float x = parseFloat(&token, lineEnd);
+            float y = parseFloat(&token, lineEnd);
+            float z = parseFloat(&token, lineEnd);
+            st->v.push_back(x);
+            st->v.push_back(y);
+            st->v.push_back(z);
+            return true;
+        }
+        
+        // normal
+        if (token[0] == 'v' && token[1] == 'n' && IS_SPACE((token[2]))) {
+            token += 3;
+            float x = parseFloat(&token, lineEnd);
+            float y = parseFloat(&token, lineEnd);
+            float z = parseFloat(&token, lineEnd);
+            st->vn.push_back(x);
+            st->vn.push_back(y);
+            st->vn.push_back(z);
+            return true;
+        }
+        
+        // texcoord
+        if (token[0] == 'v' && token[1] == 't' && IS_SPACE((token[2]))) {
+            token += 3;
+            float x = parseFloat(&token, lineEnd);
+            float y = parseFloat(&token, lineEnd);
+            st->vt.push_back(x);
+            st->vt.push_back(y);
+            return true;
+        }
+        
+        // face
+        if (token[0] == 'f' && IS_SPACE((token[1]))) {
+            token = skipSpace(token + 2, lineEnd);
+            
+            int vsize = static_cast<int>(st->v.size() / 3);
+            int vnsize = static_cast<int>(st->vn.size() / 3);
+            int vtsize = static_cast<int>(st->vt.size() / 2);
+            int nverts = 0;
+            while (token < lineEnd) {
+                unsigned char relative;
+                vertex_index vi =
+                parseTriple(&token, lineEnd, vsize, vnsize, vtsize, &relative);
+                st->faceGroup.push(vi, relative);
+                nverts++;
+                while (token < lineEnd && (IS_SPACE(*token) || *token == '\r')) token++;
+            }
+            st->faceGroup.sizes.push_back(nverts);
+            
+            return true;
+        }
+        
+        // use mtl
+        if ((0 == strncmp(token, "usemtl", 6)) && IS_SPACE((token[6]))) {
+            char namebuf[TINYOBJ_SSCANF_BUFFER_SIZE];
+            token += 7;
+#ifdef _MSC_VER
+            sscanf_s(token, "%s", namebuf, (unsigned)_countof(namebuf));
+#else
+            sscanf(token, "%s", namebuf);
+#endif
+            
+            int newMaterialId = -1;
+            if (st->material_map.find(namebuf) != st->material_map.end()) {
+                newMaterialId = st->material_map[namebuf];
+            } else {
+                // { error!! material not found }
+            }
+            
+            if (newMaterialId != st->material) {
+                // Create per-face material. Thus we don't add `shape` to `shapes` at
+                // this time.
+                // just clear `faceGroup` after `exportFaceGroupToShape()` call.
+                exportFaceGroupToShape(&st->shape, st->faceGroup, st->tags,
+                                       st->material, st->name, triangulate);
+                st->faceGroup.clear();
+                st->material = newMaterialId;
+            }
+            
+            return true;
+        }
+        
+        // load mtl
+        if ((0 == strncmp(token, "mtllib", 6)) && IS_SPACE((token[6]))) {
+            if (readMatFn) {
+                char namebuf[TINYOBJ_SSCANF_BUFFER_SIZE];
+                token += 7;
+#ifdef _MSC_VER
+                sscanf_s(token, "%s", namebuf, (unsigned)_countof(namebuf));
+#else
+                sscanf(token, "%s", namebuf);
+#endif
+                
+                std::string err_mtl;
+                bool ok = (*readMatFn)(namebuf, materials, &st->material_map, &err_mtl);
+                if (err) {
+                    (*err) += err_mtl;
+                }
+                
+                if (!ok) {
+                    st->faceGroup.clear();  // for safety
+                    return false;
+                }
+            }
+            
+            return true;
+        }
+        
+        // group name
+        if (token[0] == 'g' && IS_SPACE((token[1]))) {
+            // flush previous face group.
+            bool ret = exportFaceGroupToShape(&st->shape, st->faceGroup, st->tags,
+                                              st->material, st->name, triangulate);
+            if (ret) {
+                shapes->push_back(st->shape);
+            }
+            
+            st->shape = shape_t();
+            
+            // material = -1;
+            st->faceGroup.clear();
+            
+            std::vector<std::string> names;
+            names.reserve(2);
+            
+            while (!IS_NEW_LINE(token[0])) {
+                std::string str = parseString(&token);
+                names.push_back(str);
+                token += strspn(token, " \t\r");  // skip tag
+            }
+            
+            assert(names.size() > 0);
+            
+            // names[0] must be 'g', so skip the 0th element.
+            if (names.size() > 1) {
+                st->name = names[1];
+            } else {
+                st->name = "";
+            }
+            
+            return true;
+        }
+        
+        // object name
+        if (token[0] == 'o' && IS_SPACE((token[1]))) {
+            // flush previous face group.
+            bool ret = exportFaceGroupToShape(&st->shape, st->faceGroup, st->tags,
+                                              st->material, st->name, triangulate);
+            if (ret) {
+                shapes->push_back(st->shape);
+            }
+            
+            // material = -1;
+            st->faceGroup.clear();
+            st->shape = shape_t();
+            
+            // @todo { multiple object name? }
+            char namebuf[TINYOBJ_SSCANF_BUFFER_SIZE];
+            token += 2;
+#ifdef _MSC_VER
+            sscanf_s(token, "%s", namebuf, (unsigned)_countof(namebuf));
+#else
+            sscanf(token, "%s", namebuf);
+#endif
+            st->name = std::string(namebuf);
+            
+            return true;
+        }
+        
+        if (token[0] == 't' && IS_SPACE(token[1])) {
+            tag_t tag;
+            
+            char namebuf[4096];
+            token += 2;
+#ifdef _MSC_VER
+            sscanf_s(token, "%s", namebuf, (unsigned)_countof(namebuf));
+#else
+            sscanf(token, "%s", namebuf);
+#endif
+            tag.name = std::string(namebuf);
+            
+            token += tag.name.size() + 1;
+            
+            tag_sizes ts = parseTagTriple(&token);
+            
+            tag.intValues.resize(static_cast<size_t>(ts.num_ints));
+            
+            for (size_t i = 0; i < static_cast<size_t>(ts.num_ints); ++i) {
+                tag.intValues[i] = atoi(token);
+                token += strcspn(token, "/ \t\r") + 1;
+            }
+            
+            tag.floatValues.resize(static_cast<size_t>(ts.num_floats));
+            for (size_t i = 0; i < static_cast<size_t>(ts.num_floats); ++i) {
+                tag.floatValues[i] = parseFloat(&token);
+                token += strcspn(token, "/ \t\r") + 1;
+            }
+            
+            tag.stringValues.resize(static_cast<size_t>(ts.num_strings));
+            for (size_t i = 0; i < static_cast<size_t>(ts.num_strings); ++i) {
+                char stringValueBuffer[4096];
+                
+#ifdef _MSC_VER
+                sscanf_s(token, "%s", stringValueBuffer,
+                         (unsigned)_countof(stringValueBuffer));
+#else
+                sscanf(token, "%s", stringValueBuffer);
+#endif
+                tag.stringValues[i] = stringValueBuffer;
+                token += tag.stringValues[i].size() + 1;
+            }
+            
+            st->tags.push_back(tag);
+        }
+        
+        // Ignore unknown command.
+        return true;
+    }
+    
+    // Flushes the last face group and hands the vertex data over to `attrib`.
+    static void finishObj(obj_parse_state *st, attrib_t *attrib,
+                          std::vector<shape_t> *shapes, bool triangulate) {
+        bool ret = exportFaceGroupToShape(&st->shape, st->faceGroup, st->tags,
+                                          st->material, st->name, triangulate);
+        // exportFaceGroupToShape return false when `usemtl` is called in the last
+        // line.
+        // we also add `shape` to `shapes` when `shape.mesh` has already some
+        // faces(indices)
+        if (ret || st->shape.mesh.indices.size()) {
+            shapes->push_back(st->shape);
+        }
+        st->faceGroup.clear();  // for safety
+        
+        attrib->vertices.swap(st->v);
+        attrib->normals.swap(st->vn);
+        attrib->texcoords.swap(st->vt);
+    }
+    
     bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
                  std::vector<material_t> *materials, std::string *err,
                  const char *filename, const char *mtl_basepath,
@@ -1085,6 +1562,300 @@ namespace tinyobj {
                        trianglulate);
     }
     
+    // Non-geometry line of an .obj chunk, replayed in file order once every
+    // chunk has been tokenized. `faces` and `faceVertices` count the chunk's
+    // faces and face vertices that come before it.
+    struct obj_command {
+        const char *begin;
+        const char *end;
+        size_t faces;
+        size_t faceVertices;
+    };
+    
+    // Parses the mapped .obj text in [p, end).
+    // When `commands` is given, only 'v', 'vn', 'vt' and 'f' lines are parsed;
+    // everything else is recorded in `commands` (see LoadObjParallel()).
+    // Returns false when a referenced .mtl could not be loaded.
+    static bool parseMappedObj(obj_parse_state *st, std::vector<shape_t> *shapes,
+                               std::vector<material_t> *materials,
+                               std::string *err, MaterialReader *readMatFn,
+                               bool triangulate, const char *p, const char *end,
+                               std::vector<obj_command> *commands) {
+        std::string linebuf;
+        
+        while (p < end) {
+            const char *newline =
+            static_cast<const char *>(memchr(p, '\n', static_cast<size_t>(end - p)));
+            const char *lineEnd = newline ? newline : end;
+            const char *token = skipSpace(p, lineEnd);
+            p = newline ? newline + 1 : end;
+            
+            // Trim '\r' of '\r\n'
+            if (lineEnd > token && lineEnd[-1] == '\r') lineEnd--;
+            
+            if (token == lineEnd) continue;  // empty line
+            
+            if (token[0] == '#') continue;  // comment line
+            
+            bool geometry = (token[0] == 'v' || token[0] == 'f');
+            
+            if (commands && !geometry) {
+                obj_command command;
+                command.begin = token;
+                command.end = lineEnd;
+                command.faces = st->faceGroup.sizes.size();
+                command.faceVertices = st->faceGroup.vertices.size();
+                commands->push_back(command);
+                continue;
+            }
+            
+            // Geometry lines are parsed straight from the mapping. The rare
+            // remaining commands rely on NUL-terminated helpers, so they get a
+            // copy, as does a last line with no newline after it (the in-place
+            // checks peek one byte past the keyword).
+            if (!newline || !geometry) {
+                linebuf.assign(token, lineEnd);
+                token = linebuf.c_str();
+                lineEnd = token + linebuf.size();
+            }
+            
+            if (!parseObjLine(st, shapes, materials, err, readMatFn, triangulate,
+                              token, lineEnd)) {
+                return false;
+            }
+        }
+        
+        return true;
+    }
+    
+    bool LoadObjMapped(attrib_t *attrib, std::vector<shape_t> *shapes,
+                       std::vector<material_t> *materials, std::string *err,
+                       const char *filename, const char *mtl_basepath,
+                       bool triangulate) {
+        attrib->vertices.clear();
+        attrib->normals.clear();
+        attrib->texcoords.clear();
+        shapes->clear();
+        
+        MappedFile file;
+        if (!file.open(filename)) {
+            std::stringstream errss;
+            errss << "Cannot open file [" << filename << "]" << std::endl;
+            if (err) {
+                (*err) = errss.str();
+            }
+            return false;
+        }
+        
+        std::string basePath;
+        if (mtl_basepath) {
+            basePath = mtl_basepath;
+        }
+        MaterialFileReader matFileReader(basePath);
+        
+        obj_parse_state st;
+        if (!parseMappedObj(&st, shapes, materials, err, &matFileReader,
+                            triangulate, file.data(), file.data() + file.size(),
+                            NULL)) {
+            return false;
+        }
+        
+        finishObj(&st, attrib, shapes, triangulate);
+        
+        return true;
+    }
+    
+    // One line-aligned slice of the file, tokenized on its own thread.
+    // Face indices in `st` are chunk-local until rebaseObjChunk() runs.
+    struct obj_chunk {
+        const char *begin;
+        const char *end;
+        obj_parse_state st;
+        std::vector<obj_command> commands;
+        
+        // Offsets of this chunk's v/vt/vn data in the whole file.
+        size_t vBase;
+        size_t vtBase;
+        size_t vnBase;
+    };
+    
+    static void parseObjChunk(obj_chunk *chunk) {
+        parseMappedObj(&chunk->st, NULL, NULL, NULL, NULL, true, chunk->begin,
+                       chunk->end, &chunk->commands);
+    }
+    
+    // Copies the chunk's vertex data into `attrib` and makes its face indices
+    // file-global. Absolute indices already are; relative ones were resolved
+    // against the chunk's own vertex counts, so they get shifted by the
+    // vertices of all previous chunks.
+    static void rebaseObjChunk(obj_chunk *chunk, attrib_t *attrib) {
+        obj_parse_state &st = chunk->st;
+        if (!st.v.empty()) {
+            memcpy(&attrib->vertices[chunk->vBase * 3], &st.v[0],
+                   st.v.size() * sizeof(float));
+        }
+        if (!st.vt.empty()) {
+            memcpy(&attrib->texcoords[chunk->vtBase * 2], &st.vt[0],
+                   st.vt.size() * sizeof(float));
+        }
+        if (!st.vn.empty()) {
+            memcpy(&attrib->normals[chunk->vnBase * 3], &st.vn[0],
+                   st.vn.size() * sizeof(float));
+        }
+        
+        face_group &faceGroup = st.faceGroup;
+        if (!faceGroup.hasRelative) {
+            return;
+        }
+        for (size_t i = 0; i < faceGroup.vertices.size(); i++) {
+            unsigned char rel = faceGroup.relative[i];
+            if (rel & RELATIVE_V) faceGroup.vertices[i].v_idx += static_cast<int>(chunk->vBase);
+            if (rel & RELATIVE_VT) faceGroup.vertices[i].vt_idx += static_cast<int>(chunk->vtBase);
+            if (rel & RELATIVE_VN) faceGroup.vertices[i].vn_idx += static_cast<int>(chunk->vnBase);
+        }
+    }
+    
+    // Appends faces [face, lastFace) of `src`, whose vertices start at
+    // `faceVertex`, to `dst`.
+    static void appendFaces(face_group *dst, const face_group &src, size_t face,
+                            size_t faceVertex, size_t lastFace,
+                            size_t lastFaceVertex) {
+        dst->sizes.insert(dst->sizes.end(), src.sizes.begin() + face,
+                          src.sizes.begin() + lastFace);
+        dst->vertices.insert(dst->vertices.end(), src.vertices.begin() + faceVertex,
+                             src.vertices.begin() + lastFaceVertex);
+    }
+    
+    bool LoadObjParallel(attrib_t *attrib, std::vector<shape_t> *shapes,
+                         std::vector<material_t> *materials, std::string *err,
+                         const char *filename, const char *mtl_basepath,
+                         bool triangulate, unsigned int num_threads) {
+        attrib->vertices.clear();
+        attrib->normals.clear();
+        attrib->texcoords.clear();
+        shapes->clear();
+        
+        MappedFile file;
+        if (!file.open(filename)) {
+            std::stringstream errss;
+            errss << "Cannot open file [" << filename << "]" << std::endl;
+            if (err) {
+                (*err) = errss.str();
+            }
+            return false;
+        }
+        
+        std::string basePath;
+        if (mtl_basepath) {
+            basePath = mtl_basepath;
+        }
+        MaterialFileReader matFileReader(basePath);
+        
+        const char *data = file.data();
+        const char *end = data + file.size();
+        
+        // Starting a thread only pays off for a few hundred KB of text.
+        const size_t min_chunk_size = 256 * 1024;
+        size_t num_chunks = num_threads ? num_threads : std::thread::hardware_concurrency();
+        if (num_chunks > file.size() / min_chunk_size) {
+            num_chunks = file.size() / min_chunk_size;
+        }
+        
+        obj_parse_state st;
+        
+        if (num_chunks <= 1) {
+            if (!parseMappedObj(&st, shapes, materials, err, &matFileReader,
+                                triangulate, data, end, NULL)) {
+                return false;
+            }
+            finishObj(&st, attrib, shapes, triangulate);
+            return true;
+        }
+        
+        // Split at line boundaries.
+        std::vector<obj_chunk> chunks(num_chunks);
+        const char *begin = data;
+        for (size_t i = 0; i < num_chunks; i++) {
+            const char *split = end;
+            if (i + 1 < num_chunks) {
+                split = data + file.size() / num_chunks * (i + 1);
+                if (split < begin) split = begin;
+                const char *newline = static_cast<const char *>(
+                                                                 memchr(split, '\n', static_cast<size_t>(end - split)));
+                split = newline ? newline + 1 : end;
+            }
+            chunks[i].begin = begin;
+            chunks[i].end = split;
+            begin = split;
+        }
+        
+        // Tokenize all chunks, one of them on the calling thread.
+        std::vector<std::thread> workers;
+        for (size_t i = 1; i < num_chunks; i++) {
+            workers.push_back(std::thread(parseObjChunk, &chunks[i]));
+        }
+        parseObjChunk(&chunks[0]);
+        for (size_t i = 0; i < workers.size(); i++) {
+            workers[i].join();
+        }
+        workers.clear();
+        
+        // Vertex data offsets of each chunk within the file.
+        size_t vCount = 0, vtCount = 0, vnCount = 0;
+        for (size_t i = 0; i < num_chunks; i++) {
+            chunks[i].vBase = vCount;
+            chunks[i].vtBase = vtCount;
+            chunks[i].vnBase = vnCount;
+            vCount += chunks[i].st.v.size() / 3;
+            vtCount += chunks[i].st.vt.size() / 2;
+            vnCount += chunks[i].st.vn.size() / 3;
+        }
+        attrib->vertices.resize(vCount * 3);
+        attrib->texcoords.resize(vtCount * 2);
+        attrib->normals.resize(vnCount * 3);
+        
+        for (size_t i = 1; i < num_chunks; i++) {
+            workers.push_back(std::thread(rebaseObjChunk, &chunks[i], attrib));
+        }
+        rebaseObjChunk(&chunks[0], attrib);
+        for (size_t i = 0; i < workers.size(); i++) {
+            workers[i].join();
+        }
+        
+        // Replay faces and commands (usemtl, g, o, ...) in file order; this
+        // builds the shapes exactly like the serial parser does.
+        std::string linebuf;
+        for (size_t i = 0; i < num_chunks; i++) {
+            const face_group &faceGroup = chunks[i].st.faceGroup;
+            const std::vector<obj_command> &commands = chunks[i].commands;
+            size_t face = 0;
+            size_t faceVertex = 0;
+            
+            for (size_t c = 0; c < commands.size(); c++) {
+                appendFaces(&st.faceGroup, faceGroup, face, faceVertex,
+                            commands[c].faces, commands[c].faceVertices);
+                face = commands[c].faces;
+                faceVertex = commands[c].faceVertices;
+                
+                linebuf.assign(commands[c].begin, commands[c].end);
+                if (!parseObjLine(&st, shapes, materials, err, &matFileReader,
+                                  triangulate, linebuf.c_str(),
+                                  linebuf.c_str() + linebuf.size())) {
+                    return false;
+                }
+            }
+            appendFaces(&st.faceGroup, faceGroup, face, faceVertex,
+                        faceGroup.sizes.size(), faceGroup.vertices.size());
+        }
+        
+        st.v.swap(attrib->vertices);
+        st.vt.swap(attrib->texcoords);
+        st.vn.swap(attrib->normals);
+        finishObj(&st, attrib, shapes, triangulate);
+        
+        return true;
+    }
+    
     bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
                  std::vector<material_t> *materials, std::string *err,
                  std::istream *inStream,
@@ -1092,18 +1863,7 @@ namespace tinyobj {
                  bool triangulate) {
         std::stringstream errss;
         
-        std::vector<float> v;
-        std::vector<float> vn;
-        std::vector<float> vt;
-        std::vector<tag_t> tags;
-        std::vector<std::vector<vertex_index> > faceGroup;
-        std::string name;
-        
-        // material
-        std::map<std::string, int> material_map;
-        int material = -1;
-        
-        shape_t shape;
+        obj_parse_state st;
         
         std::string linebuf;
         while (inStream->peek() != -1) {
@@ -1133,247 +1893,18 @@ namespace tinyobj {
             
             if (token[0] == '#') continue;  // comment line
             
-            // vertex
-            if (token[0] == 'v' && IS_SPACE((token[1]))) {
-                token += 2;
-                float x, y, z;
-                parseFloat3(&x, &y, &z, &token);
-                v.push_back(x);
-                v.push_back(y);
-                v.push_back(z);
-                continue;
-            }
-            
-            // normal
-            if (token[0] == 'v' && token[1] == 'n' && IS_SPACE((token[2]))) {
-                token += 3;
-                float x, y, z;
-                parseFloat3(&x, &y, &z, &token);
-                vn.push_back(x);
-                vn.push_back(y);
-                vn.push_back(z);
-                continue;
-            }
-            
-            // texcoord
-            if (token[0] == 'v' && token[1] == 't' && IS_SPACE((token[2]))) {
-                token += 3;
-                float x, y;
-                parseFloat2(&x, &y, &token);
-                vt.push_back(x);
-                vt.push_back(y);
-                continue;
-            }
-            
-            // face
-            if (token[0] == 'f' && IS_SPACE((token[1]))) {
-                token += 2;
-                token += strspn(token, " \t");
-                
-                std::vector<vertex_index> face;
-                face.reserve(3);
-                
-                while (!IS_NEW_LINE(token[0])) {
-                    vertex_index vi = parseTriple(&token, static_cast<int>(v.size() / 3),
-                                                  static_cast<int>(vn.size() / 3),
-                                                  static_cast<int>(vt.size() / 2));
-                    face.push_back(vi);
-                    size_t n = strspn(token, " \t\r");
-                    token += n;
-                }
-                
-                // replace with emplace_back + std::move on C++11
-                faceGroup.push_back(std::vector<vertex_index>());
-                faceGroup[faceGroup.size() - 1].swap(face);
-                
-                continue;
-            }
-            
-            // use mtl
-            if ((0 == strncmp(token, "usemtl", 6)) && IS_SPACE((token[6]))) {
-                char namebuf[TINYOBJ_SSCANF_BUFFER_SIZE];
-                token += 7;
-#ifdef _MSC_VER
-                sscanf_s(token, "%s", namebuf, (unsigned)_countof(namebuf));
-#else
-                sscanf(token, "%s", namebuf);
-#endif
-                
-                int newMaterialId = -1;
-                if (material_map.find(namebuf) != material_map.end()) {
-                    newMaterialId = material_map[namebuf];
-                } else {
-                    // { error!! material not found }
-                }
-                
-                if (newMaterialId != material) {
-                    // Create per-face material. Thus we don't add `shape` to `shapes` at
-                    // this time.
-                    // just clear `faceGroup` after `exportFaceGroupToShape()` call.
-                    exportFaceGroupToShape(&shape, faceGroup, tags, material, name,
-                                           triangulate);
-                    faceGroup.clear();
-                    material = newMaterialId;
-                }
-                
-                continue;
-            }
-            
-            // load mtl
-            if ((0 == strncmp(token, "mtllib", 6)) && IS_SPACE((token[6]))) {
-                if (readMatFn) {
-                    char namebuf[TINYOBJ_SSCANF_BUFFER_SIZE];
-                    token += 7;
-#ifdef _MSC_VER
-                    sscanf_s(token, "%s", namebuf, (unsigned)_countof(namebuf));
-#else
-                    sscanf(token, "%s", namebuf);
-#endif
-                    
-                    std::string err_mtl;
-                    bool ok = (*readMatFn)(namebuf, materials, &material_map, &err_mtl);
-                    if (err) {
-                        (*err) += err_mtl;
-                    }
-                    
-                    if (!ok) {
-                        faceGroup.clear();  // for safety
-                        return false;
-                    }
-                }
-                
-                continue;
-            }
-            
-            // group name
-            if (token[0] == 'g' && IS_SPACE((token[1]))) {
-                // flush previous face group.
-                bool ret = exportFaceGroupToShape(&shape, faceGroup, tags, material, name,
-                                                  triangulate);
-                if (ret) {
-                    shapes->push_back(shape);
-                }
-                
-                shape = shape_t();
-                
-                // material = -1;
-                faceGroup.clear();
-                
-                std::vector<std::string> names;
-                names.reserve(2);
-                
-                while (!IS_NEW_LINE(token[0])) {
-                    std::string str = parseString(&token);
-                    names.push_back(str);
-                    token += strspn(token, " \t\r");  // skip tag
-                }
-                
-                assert(names.size() > 0);
-                
-                // names[0] must be 'g', so skip the 0th element.
-                if (names.size() > 1) {
-                    name = names[1];
-                } else {
-                    name = "";
-                }
-                
-                continue;
-            }
-            
-            // object name
-            if (token[0] == 'o' && IS_SPACE((token[1]))) {
-                // flush previous face group.
-                bool ret = exportFaceGroupToShape(&shape, faceGroup, tags, material, name,
-                                                  triangulate);
-                if (ret) {
-                    shapes->push_back(shape);
-                }
-                
-                // material = -1;
-                faceGroup.clear();
-                shape = shape_t();
-                
-                // @todo { multiple object name? }
-                char namebuf[TINYOBJ_SSCANF_BUFFER_SIZE];
-                token += 2;
-#ifdef _MSC_VER
-                sscanf_s(token, "%s", namebuf, (unsigned)_countof(namebuf));
-#else
-                sscanf(token, "%s", namebuf);
-#endif
-                name = std::string(namebuf);
-                
-                continue;
-            }
-            
-            if (token[0] == 't' && IS_SPACE(token[1])) {
-                tag_t tag;
-                
-                char namebuf[4096];
-                token += 2;
-#ifdef _MSC_VER
-                sscanf_s(token, "%s", namebuf, (unsigned)_countof(namebuf));
-#else
-                sscanf(token, "%s", namebuf);
-#endif
-                tag.name = std::string(namebuf);
-                
-                token += tag.name.size() + 1;
-                
-                tag_sizes ts = parseTagTriple(&token);
-                
-                tag.intValues.resize(static_cast<size_t>(ts.num_ints));
-                
-                for (size_t i = 0; i < static_cast<size_t>(ts.num_ints); ++i) {
-                    tag.intValues[i] = atoi(token);
-                    token += strcspn(token, "/ \t\r") + 1;
-                }
-                
-                tag.floatValues.resize(static_cast<size_t>(ts.num_floats));
-                for (size_t i = 0; i < static_cast<size_t>(ts.num_floats); ++i) {
-                    tag.floatValues[i] = parseFloat(&token);
-                    token += strcspn(token, "/ \t\r") + 1;
-                }
-                
-                tag.stringValues.resize(static_cast<size_t>(ts.num_strings));
-                for (size_t i = 0; i < static_cast<size_t>(ts.num_strings); ++i) {
-                    char stringValueBuffer[4096];
-                    
-#ifdef _MSC_VER
-                    sscanf_s(token, "%s", stringValueBuffer,
-                             (unsigned)_countof(stringValueBuffer));
-#else
-                    sscanf(token, "%s", stringValueBuffer);
-#endif
-                    tag.stringValues[i] = stringValueBuffer;
-                    token += tag.stringValues[i].size() + 1;
-                }
-                
-                tags.push_back(tag);
+            if (!parseObjLine(&st, shapes, materials, err, readMatFn, triangulate,
+                              token, linebuf.c_str() + linebuf.size())) {
+                return false;
             }
-            
-            // Ignore unknown command.
         }
         
-        bool ret = exportFaceGroupToShape(&shape, faceGroup, tags, material, name,
-                                          triangulate);
-        // exportFaceGroupToShape return false when `usemtl` is called in the last
-        // line.
-        // we also add `shape` to `shapes` when `shape.mesh` has already some
-        // faces(indices)
-        if (ret || shape.mesh.indices.size()) {
-            shapes->push_back(shape);
-        }
-        faceGroup.clear();  // for safety
+        finishObj(&st, attrib, shapes, triangulate);
         
         if (err) {
             (*err) += errss.str();
         }
         
-        attrib->vertices.swap(v);
-        attrib->normals.swap(vn);
-        attrib->texcoords.swap(vt);
-        
         return true;
     }
     